@@ -0,0 +1,186 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+	#include <malloc.h> // _aligned_malloc
+#endif
+
+namespace
+{
+
+std::atomic<std::uint64_t> g_allocationCount{ 0 };
+std::atomic<bool>          g_countingEnabled{ false };
+
+void CountAllocation() noexcept
+{
+	if (g_countingEnabled.load(std::memory_order_relaxed))
+	{
+		g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void* CountedAlloc(std::size_t size) noexcept
+{
+	CountAllocation();
+	return std::malloc((size != 0) ? size : 1);
+}
+
+void* CountedAlignedAlloc(std::size_t size, const std::align_val_t alignment) noexcept
+{
+	CountAllocation();
+
+	const auto align = static_cast<std::size_t>(alignment);
+	size = (size != 0) ? size : 1;
+
+#if defined(_MSC_VER)
+	return _aligned_malloc(size, align);
+#else
+	// aligned_alloc wants a multiple of the alignment.
+	return std::aligned_alloc(align, (size + align - 1) & ~(align - 1));
+#endif
+}
+
+void AlignedFree(void* ptr) noexcept
+{
+#if defined(_MSC_VER)
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+} // namespace
+
+namespace console
+{
+
+std::uint64_t AllocationCount()
+{
+	return g_allocationCount.load(std::memory_order_relaxed);
+}
+
+void SetAllocationCounting(const bool enabled)
+{
+	g_countingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+} // namespace console
+
+// ========================================================
+// Replacement global allocation functions
+// ========================================================
+
+void* operator new(std::size_t size)
+{
+	void* ptr = CountedAlloc(size);
+	if (ptr == nullptr)
+	{
+		throw std::bad_alloc{};
+	}
+	return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+// Over-aligned types (alignas above __STDCPP_DEFAULT_NEW_ALIGNMENT__) go through these.
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	void* ptr = CountedAlignedAlloc(size, alignment);
+	if (ptr == nullptr)
+	{
+		throw std::bad_alloc{};
+	}
+	return ptr;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAlignedAlloc(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+	AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+	AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	AlignedFree(ptr);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+namespace console
+{
+
+// Number of calls to the global operator new (including the aligned forms) while counting
+// was enabled, from any thread. Backed by the replacement allocation functions in
+// AllocationCounter.cpp; used by the --alloc-check mode to verify that steady-state frames don't allocate.
+std::uint64_t AllocationCount();
+
+// Counting is off by default, so other modes only pay for a relaxed load per allocation.
+void SetAllocationCounting(const bool enabled);
+
+} // namespace console
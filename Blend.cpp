@@ -0,0 +1,112 @@
+#include "Blend.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+	#define CONSOLE_BLEND_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+namespace console
+{
+
+namespace
+{
+
+// x / 255, rounded. Exact for x <= 255 * 255.
+inline unsigned Div255(const unsigned x)
+{
+	return (x + 128 + ((x + 128) >> 8)) >> 8;
+}
+
+std::uint32_t BlendPixel(const std::uint32_t dst, const std::uint32_t src, const BlendMode mode, const unsigned opacity)
+{
+	std::uint32_t result = 0;
+
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		const unsigned d = (dst >> shift) & 0xFF;
+		const unsigned s = (src >> shift) & 0xFF;
+
+		unsigned target = s;
+		switch (mode)
+		{
+		case BlendMode::Alpha    : target = s; break;
+		case BlendMode::Multiply : target = Div255(d * s); break;
+		case BlendMode::Add      : target = std::min(d + s, 255u); break;
+		}
+
+		result |= Div255((d * (255 - opacity)) + (target * opacity)) << shift;
+	}
+
+	return result;
+}
+
+#if CONSOLE_BLEND_SSE2
+
+// Same as the scalar Div255, on 8 x 16-bit lanes.
+inline __m128i Div255(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Blends 2 pixels unpacked to 16-bit channels.
+inline __m128i BlendHalf(const __m128i d, const __m128i s, const BlendMode mode, const __m128i opacity, const __m128i inverse)
+{
+	__m128i target = s;
+	switch (mode)
+	{
+	case BlendMode::Alpha    : target = s; break;
+	case BlendMode::Multiply : target = Div255(_mm_mullo_epi16(d, s)); break;
+	case BlendMode::Add      : target = _mm_min_epi16(_mm_add_epi16(d, s), _mm_set1_epi16(255)); break;
+	}
+
+	return Div255(_mm_add_epi16(_mm_mullo_epi16(d, inverse), _mm_mullo_epi16(target, opacity)));
+}
+
+#endif // CONSOLE_BLEND_SSE2
+
+} // namespace
+
+void BlendRow(std::uint32_t* pixels, const std::uint16_t* depth, const int count, const std::uint16_t z,
+	const std::uint32_t colour, const BlendMode mode, const std::uint8_t opacity)
+{
+	assert(pixels != nullptr && depth != nullptr);
+
+	int i = 0;
+
+#if CONSOLE_BLEND_SSE2
+	const __m128i zero     = _mm_setzero_si128();
+	const __m128i src      = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(colour)), zero);
+	const __m128i alpha    = _mm_set1_epi16(static_cast<short>(opacity));
+	const __m128i inverse  = _mm_set1_epi16(static_cast<short>(255 - opacity));
+	const __m128i layer    = _mm_set1_epi32(z);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+
+		const __m128i lo = BlendHalf(_mm_unpacklo_epi8(d, zero), src, mode, alpha, inverse);
+		const __m128i hi = BlendHalf(_mm_unpackhi_epi8(d, zero), src, mode, alpha, inverse);
+		const __m128i blended = _mm_packus_epi16(lo, hi);
+
+		// Pixels in front of the layer keep their colour.
+		const __m128i depth4 = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(depth + i)), zero);
+		const __m128i keep   = _mm_cmplt_epi32(depth4, layer);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, blended)));
+	}
+#endif // CONSOLE_BLEND_SSE2
+
+	for (; i < count; ++i)
+	{
+		if (depth[i] >= z)
+		{
+			pixels[i] = BlendPixel(pixels[i], colour, mode, opacity);
+		}
+	}
+}
+
+} // namespace console
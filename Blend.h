@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Screen.h"
+
+#include <cstdint>
+
+namespace console
+{
+
+// Colours are kept packed as 0x00BBGGRR, 4 per 128-bit register.
+inline std::uint32_t PackColour(const Colour colour)
+{
+	return static_cast<std::uint32_t>(colour.r) | (static_cast<std::uint32_t>(colour.g) << 8) | (static_cast<std::uint32_t>(colour.b) << 16);
+}
+
+inline Colour UnpackColour(const std::uint32_t packed)
+{
+	Colour colour;
+	colour.r = static_cast<std::uint8_t>(packed);
+	colour.g = static_cast<std::uint8_t>(packed >> 8);
+	colour.b = static_cast<std::uint8_t>(packed >> 16);
+	return colour;
+}
+
+// Blends colour into each pixel whose depth is >= z (same layer or behind it), at opacity/255.
+// Uses SSE2 where available, 4 pixels per iteration.
+void BlendRow(std::uint32_t* pixels, const std::uint16_t* depth, const int count, const std::uint16_t z,
+	const std::uint32_t colour, const BlendMode mode, const std::uint8_t opacity);
+
+} // namespace console
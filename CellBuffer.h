@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace console
+{
+
+// Shifts whole lines of a rectangular area of a row-major cell buffer, up for lines > 0
+// or down for lines < 0. Columns are [left, right) and rows are [top, bottom).
+// Uncovered lines are set to fill. Cell must be trivially copyable.
+template<typename Cell>
+void ScrollCells(Cell* cells, const int stride, const int left, const int right, const int top, const int bottom, const int lines, const Cell& fill)
+{
+	const int columns = right - left;
+	const int rows    = bottom - top;
+	const int shift   = std::min(std::abs(lines), rows);
+
+	if (columns <= 0 || rows <= 0 || shift == 0)
+	{
+		return;
+	}
+
+	const bool fullWidth = (left == 0 && right == stride);
+	const int  moved     = rows - shift;
+
+	if (lines > 0)
+	{
+		if (fullWidth)
+		{
+			std::memmove(cells + (top * stride), cells + ((top + shift) * stride), sizeof(Cell) * static_cast<std::size_t>(moved * stride));
+		}
+		else
+		{
+			for (int y = top; y < top + moved; ++y)
+			{
+				std::memmove(cells + (y * stride) + left, cells + ((y + shift) * stride) + left, sizeof(Cell) * static_cast<std::size_t>(columns));
+			}
+		}
+
+		for (int y = bottom - shift; y < bottom; ++y)
+		{
+			std::fill(cells + (y * stride) + left, cells + (y * stride) + right, fill);
+		}
+	}
+	else
+	{
+		if (fullWidth)
+		{
+			std::memmove(cells + ((top + shift) * stride), cells + (top * stride), sizeof(Cell) * static_cast<std::size_t>(moved * stride));
+		}
+		else
+		{
+			for (int y = bottom - 1; y >= top + shift; --y)
+			{
+				std::memmove(cells + (y * stride) + left, cells + ((y - shift) * stride) + left, sizeof(Cell) * static_cast<std::size_t>(columns));
+			}
+		}
+
+		for (int y = top; y < top + shift; ++y)
+		{
+			std::fill(cells + (y * stride) + left, cells + (y * stride) + right, fill);
+		}
+	}
+}
+
+} // namespace console
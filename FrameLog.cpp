@@ -0,0 +1,515 @@
+#include "FrameLog.h"
+
+#include <cassert>
+#include <cstring>
+
+#define NOUSER   // Suppress DrawTextA|W macro
+#define NOGDI    // Suppress Rectangle() function
+#define NOMINMAX // Suppress min/max macros
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+namespace console
+{
+
+namespace
+{
+
+constexpr std::size_t FlushThreshold = 1024 * 1024;
+
+// Cells skipped between two changed cells before a delta run is split.
+// A run header is the size of two cells, so shorter gaps are cheaper to send as-is.
+constexpr int MaxRunGap = 2;
+
+std::uint32_t PaddedSize(const std::uint32_t size)
+{
+	return (size + 7u) & ~7u;
+}
+
+template<typename T>
+T ReadAt(const std::uint8_t* data, const std::uint64_t offset)
+{
+	T value;
+	std::memcpy(&value, data + offset, sizeof(T));
+	return value;
+}
+
+} // namespace
+
+// ========================================================
+// FrameWriter
+// ========================================================
+
+FrameWriter::~FrameWriter()
+{
+	Close();
+}
+
+bool FrameWriter::Open(const char* filename, const int width, const int height, const int keyframeInterval)
+{
+	assert(filename != nullptr);
+	assert(width > 0 && height > 0);
+	assert(keyframeInterval > 0);
+
+	Close();
+
+	HANDLE file = CreateFileA(filename, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	m_file             = file;
+	m_offset           = 0;
+	m_width            = width;
+	m_height           = height;
+	m_keyframeInterval = keyframeInterval;
+	m_lastKeyframe     = 0;
+
+	m_buffer.clear();
+	m_buffer.reserve(FlushThreshold + (static_cast<std::size_t>(width) * height * sizeof(FrameCell) * 2));
+	m_previous.clear();
+	m_runs.clear();
+	m_index.clear();
+
+	FrameLogHeader header;
+	header.width            = static_cast<std::uint16_t>(width);
+	header.height           = static_cast<std::uint16_t>(height);
+	header.keyframeInterval = static_cast<std::uint32_t>(keyframeInterval);
+	Write(&header, sizeof(header));
+
+	return true;
+}
+
+void FrameWriter::Close()
+{
+	if (m_file == nullptr)
+	{
+		return;
+	}
+
+	FrameLogTrailer trailer;
+	trailer.indexOffset = m_offset;
+	trailer.frameCount  = static_cast<std::uint32_t>(m_index.size());
+
+	if (!m_index.empty())
+	{
+		Write(m_index.data(), m_index.size() * sizeof(FrameLogIndexEntry));
+	}
+	Write(&trailer, sizeof(trailer));
+	Flush();
+
+	CloseHandle(static_cast<HANDLE>(m_file));
+	m_file = nullptr;
+}
+
+void FrameWriter::WriteFrame(const FrameCell* cells, const std::uint64_t timestampMicros)
+{
+	assert(cells != nullptr);
+
+	if (m_file == nullptr)
+	{
+		return;
+	}
+
+	const int cellCount = m_width * m_height;
+	const auto keyframeSize = static_cast<std::uint32_t>(cellCount * sizeof(FrameCell));
+	const auto frameNumber = static_cast<std::uint32_t>(m_index.size());
+
+	bool keyframe = m_previous.empty() || (frameNumber - m_lastKeyframe) >= static_cast<std::uint32_t>(m_keyframeInterval);
+	std::uint32_t deltaSize = 0;
+
+	if (!keyframe)
+	{
+		// Find runs of changed cells, merging runs separated by small gaps.
+		m_runs.clear();
+
+		for (int i = 0; i < cellCount; )
+		{
+			if (cells[i] == m_previous[i])
+			{
+				++i;
+				continue;
+			}
+
+			int lastChanged = i;
+			for (int j = i + 1; j < cellCount && (j - lastChanged) <= MaxRunGap; ++j)
+			{
+				if (cells[j] != m_previous[j])
+				{
+					lastChanged = j;
+				}
+			}
+
+			FrameLogRun run;
+			run.start = static_cast<std::uint32_t>(i);
+			run.count = static_cast<std::uint32_t>(lastChanged - i + 1);
+			m_runs.push_back(run);
+
+			deltaSize += static_cast<std::uint32_t>(sizeof(FrameLogRun) + run.count * sizeof(FrameCell));
+			i = lastChanged + 1;
+		}
+
+		// Fall back to a keyframe if the delta wouldn't be any smaller.
+		if (deltaSize >= keyframeSize || m_runs.size() > 0xFFFF)
+		{
+			keyframe = true;
+		}
+	}
+
+	if (keyframe)
+	{
+		m_lastKeyframe = frameNumber;
+		BeginFrame(framelog::FrameType::Keyframe, 0, keyframeSize, timestampMicros);
+
+		Write(cells, keyframeSize);
+		m_previous.assign(cells, cells + cellCount);
+	}
+	else
+	{
+		BeginFrame(framelog::FrameType::Delta, static_cast<std::uint16_t>(m_runs.size()), PaddedSize(deltaSize), timestampMicros);
+
+		for (const FrameLogRun& run : m_runs)
+		{
+			Write(&run, sizeof(run));
+			Write(cells + run.start, run.count * sizeof(FrameCell));
+			std::memcpy(m_previous.data() + run.start, cells + run.start, run.count * sizeof(FrameCell));
+		}
+	}
+
+	// Pad payload to keep the next header 8-byte aligned.
+	static constexpr std::uint8_t padding[8] = {};
+	const std::uint32_t payloadSize = keyframe ? keyframeSize : deltaSize;
+	if (PaddedSize(payloadSize) != payloadSize)
+	{
+		Write(padding, PaddedSize(payloadSize) - payloadSize);
+	}
+
+	if (m_buffer.size() >= FlushThreshold)
+	{
+		Flush();
+	}
+}
+
+void FrameWriter::BeginFrame(const framelog::FrameType type, const std::uint16_t runCount, const std::uint32_t payloadSize, const std::uint64_t timestampMicros)
+{
+	FrameLogIndexEntry entry;
+	entry.offset          = m_offset;
+	entry.timestampMicros = timestampMicros;
+	entry.keyframe        = m_lastKeyframe;
+	m_index.push_back(entry);
+
+	FrameLogFrameHeader header;
+	header.type            = type;
+	header.runCount        = runCount;
+	header.payloadSize     = PaddedSize(payloadSize);
+	header.timestampMicros = timestampMicros;
+	Write(&header, sizeof(header));
+}
+
+void FrameWriter::Write(const void* data, const std::size_t size)
+{
+	const auto bytes = static_cast<const std::uint8_t*>(data);
+	m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+	m_offset += size;
+}
+
+void FrameWriter::Flush()
+{
+	if (m_file == nullptr || m_buffer.empty())
+	{
+		return;
+	}
+
+	DWORD written = 0;
+	const BOOL result = WriteFile(static_cast<HANDLE>(m_file), m_buffer.data(), static_cast<DWORD>(m_buffer.size()), &written, nullptr);
+	assert(result == TRUE && written == m_buffer.size());
+
+	m_buffer.clear();
+}
+
+// ========================================================
+// FrameReader
+// ========================================================
+
+FrameReader::~FrameReader()
+{
+	Close();
+}
+
+bool FrameReader::Open(const char* filename)
+{
+	assert(filename != nullptr);
+
+	Close();
+
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	m_file = file;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(FrameLogHeader)))
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<std::uint64_t>(fileSize.QuadPart);
+
+	m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = static_cast<const std::uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_header = ReadAt<FrameLogHeader>(m_data, 0);
+	if (m_header.magic != framelog::FileMagic || m_header.version != framelog::Version ||
+		m_header.headerSize != sizeof(FrameLogHeader) || m_header.width == 0 || m_header.height == 0)
+	{
+		Close();
+		return false;
+	}
+
+	if (!BuildIndex())
+	{
+		Close();
+		return false;
+	}
+
+	m_cells.assign(static_cast<std::size_t>(m_header.width) * m_header.height, FrameCell{});
+	m_current = -1;
+
+	return true;
+}
+
+void FrameReader::Close()
+{
+	if (m_data != nullptr)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+
+	if (m_mapping != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(m_mapping));
+		m_mapping = nullptr;
+	}
+
+	if (m_file != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(m_file));
+		m_file = nullptr;
+	}
+
+	m_size    = 0;
+	m_header  = {};
+	m_current = -1;
+	m_cells.clear();
+	m_index.clear();
+}
+
+bool FrameReader::BuildIndex()
+{
+	m_index.clear();
+
+	// Fast path: the recording was closed properly and has an index.
+	if (m_size >= sizeof(FrameLogHeader) + sizeof(FrameLogTrailer))
+	{
+		const auto trailer = ReadAt<FrameLogTrailer>(m_data, m_size - sizeof(FrameLogTrailer));
+		const std::uint64_t indexSize = static_cast<std::uint64_t>(trailer.frameCount) * sizeof(FrameLogIndexEntry);
+
+		if (trailer.magic == framelog::TrailerMagic && trailer.indexOffset <= m_size &&
+			trailer.indexOffset + indexSize + sizeof(FrameLogTrailer) == m_size)
+		{
+			m_index.resize(trailer.frameCount);
+			if (indexSize != 0)
+			{
+				std::memcpy(m_index.data(), m_data + trailer.indexOffset, static_cast<std::size_t>(indexSize));
+			}
+
+			if (IndexIsValid())
+			{
+				return true;
+			}
+
+			// Corrupted, or frames were appended after a trailer: don't trust any of it.
+			m_index.clear();
+		}
+	}
+
+	// Slow path: walk every frame header, stopping at the first truncated frame.
+	const std::uint64_t keyframeSize = static_cast<std::uint64_t>(m_header.width) * m_header.height * sizeof(FrameCell);
+	std::uint64_t offset = sizeof(FrameLogHeader);
+	std::uint32_t lastKeyframe = 0;
+
+	while (offset + sizeof(FrameLogFrameHeader) <= m_size)
+	{
+		const auto header = ReadAt<FrameLogFrameHeader>(m_data, offset);
+		const std::uint64_t end = offset + sizeof(FrameLogFrameHeader) + header.payloadSize;
+
+		if (end > m_size || (header.type != framelog::FrameType::Keyframe && header.type != framelog::FrameType::Delta))
+		{
+			break;
+		}
+
+		if (header.type == framelog::FrameType::Keyframe)
+		{
+			if (header.payloadSize < keyframeSize)
+			{
+				break;
+			}
+			lastKeyframe = static_cast<std::uint32_t>(m_index.size());
+		}
+		else if (m_index.empty())
+		{
+			break; // A delta needs a keyframe before it
+		}
+
+		FrameLogIndexEntry entry;
+		entry.offset          = offset;
+		entry.timestampMicros = header.timestampMicros;
+		entry.keyframe        = lastKeyframe;
+		m_index.push_back(entry);
+
+		offset = end;
+	}
+
+	return true;
+}
+
+// Every frame of the index has to lie within the file and restart from an earlier keyframe,
+// so that ReadFrame() never reads outside the mapping.
+bool FrameReader::IndexIsValid() const
+{
+	const std::uint64_t keyframeSize = static_cast<std::uint64_t>(m_header.width) * m_header.height * sizeof(FrameCell);
+
+	for (std::size_t frame = 0; frame < m_index.size(); ++frame)
+	{
+		const FrameLogIndexEntry& entry = m_index[frame];
+
+		if (entry.offset < sizeof(FrameLogHeader) || entry.offset > m_size - sizeof(FrameLogFrameHeader))
+		{
+			return false;
+		}
+
+		const auto header = ReadAt<FrameLogFrameHeader>(m_data, entry.offset);
+		if (header.payloadSize > m_size - sizeof(FrameLogFrameHeader) - entry.offset ||
+			(header.type != framelog::FrameType::Keyframe && header.type != framelog::FrameType::Delta))
+		{
+			return false;
+		}
+
+		if (entry.keyframe > frame)
+		{
+			return false;
+		}
+
+		// The keyframe entry comes first, so it has already been checked to lie within the file.
+		const auto keyframe = ReadAt<FrameLogFrameHeader>(m_data, m_index[entry.keyframe].offset);
+		if (keyframe.type != framelog::FrameType::Keyframe || keyframe.payloadSize < keyframeSize)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FrameReader::ReadFrame(const std::uint32_t frame)
+{
+	if (frame >= m_index.size())
+	{
+		return false;
+	}
+
+	if (m_current == frame)
+	{
+		return true;
+	}
+
+	// Continue from the current frame if it's on the way, otherwise restart from the keyframe.
+	std::uint32_t first = m_index[frame].keyframe;
+	if (m_current >= static_cast<std::int64_t>(first) && m_current < static_cast<std::int64_t>(frame))
+	{
+		first = static_cast<std::uint32_t>(m_current + 1);
+	}
+
+	for (std::uint32_t f = first; f <= frame; ++f)
+	{
+		if (!DecodeFrame(f))
+		{
+			m_current = -1;
+			return false;
+		}
+		m_current = f;
+	}
+
+	return true;
+}
+
+bool FrameReader::DecodeFrame(const std::uint32_t frame)
+{
+	const std::uint64_t offset = m_index[frame].offset;
+	if (offset + sizeof(FrameLogFrameHeader) > m_size)
+	{
+		return false;
+	}
+
+	const auto header = ReadAt<FrameLogFrameHeader>(m_data, offset);
+	const std::uint8_t* payload = m_data + offset + sizeof(FrameLogFrameHeader);
+	const std::uint64_t payloadEnd = offset + sizeof(FrameLogFrameHeader) + header.payloadSize;
+
+	if (payloadEnd > m_size)
+	{
+		return false;
+	}
+
+	if (header.type == framelog::FrameType::Keyframe)
+	{
+		const std::size_t keyframeSize = m_cells.size() * sizeof(FrameCell);
+		if (header.payloadSize < keyframeSize)
+		{
+			return false;
+		}
+
+		std::memcpy(m_cells.data(), payload, keyframeSize);
+		return true;
+	}
+
+	std::uint64_t cursor = 0;
+	for (std::uint16_t r = 0; r < header.runCount; ++r)
+	{
+		if (cursor + sizeof(FrameLogRun) > header.payloadSize)
+		{
+			return false;
+		}
+
+		const auto run = ReadAt<FrameLogRun>(payload, cursor);
+		cursor += sizeof(FrameLogRun);
+
+		const std::uint64_t runSize = static_cast<std::uint64_t>(run.count) * sizeof(FrameCell);
+		if (static_cast<std::uint64_t>(run.start) + run.count > m_cells.size() || cursor + runSize > header.payloadSize)
+		{
+			return false;
+		}
+
+		std::memcpy(m_cells.data() + run.start, payload + cursor, static_cast<std::size_t>(runSize));
+		cursor += runSize;
+	}
+
+	return true;
+}
+
+} // namespace console
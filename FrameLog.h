@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace console
+{
+
+// One console cell as stored in a frame log. Mirrors the console's CHAR_INFO
+// (UTF-16 code unit + attributes) but with a fixed, platform independent layout.
+struct FrameCell
+{
+	std::uint16_t ch      = 0;
+	std::uint16_t attribs = 0;
+};
+
+static_assert(sizeof(FrameCell) == 4, "FrameCell must be tightly packed");
+
+// Attribute bits marking the two halves of a double-width (East Asian) character.
+// Same values as the console's COMMON_LVB_LEADING_BYTE/COMMON_LVB_TRAILING_BYTE; both halves hold the same ch.
+constexpr std::uint16_t CellLeadingHalf  = 0x0100;
+constexpr std::uint16_t CellTrailingHalf = 0x0200;
+
+// Foreground/background colour bits of the attributes. The other bits don't carry colour.
+constexpr std::uint16_t CellColourMask = 0x00FF;
+
+inline bool operator==(const FrameCell& a, const FrameCell& b) { return a.ch == b.ch && a.attribs == b.attribs; }
+inline bool operator!=(const FrameCell& a, const FrameCell& b) { return !(a == b); }
+
+// Frame log file layout. Every structure is 8-byte aligned, so a memory-mapped
+// file can be read in place:
+//
+//   FrameLogHeader
+//   { FrameLogFrameHeader, payload }   * frameCount
+//   FrameLogIndexEntry                 * frameCount
+//   FrameLogTrailer
+//
+// Keyframe payload: width*height FrameCells.
+// Delta payload:    runCount * { FrameLogRun, FrameCell[run.count] }, padded to 8 bytes,
+//                   applied on top of the previous frame.
+//
+// The index and trailer are written when the recording is closed. If they are
+// missing (e.g. the process crashed) the reader rebuilds the index by walking the frames.
+namespace framelog
+{
+	constexpr std::uint32_t FileMagic    = 0x4D524643; // 'CFRM'
+	constexpr std::uint32_t TrailerMagic = 0x58494643; // 'CFIX'
+	constexpr std::uint16_t Version      = 1;
+
+	enum class FrameType : std::uint16_t
+	{
+		Keyframe,
+		Delta,
+	};
+} // namespace framelog
+
+struct FrameLogHeader
+{
+	std::uint32_t magic            = framelog::FileMagic;
+	std::uint16_t version          = framelog::Version;
+	std::uint16_t headerSize       = sizeof(FrameLogHeader);
+	std::uint16_t width            = 0;
+	std::uint16_t height           = 0;
+	std::uint32_t keyframeInterval = 0;
+};
+
+struct FrameLogFrameHeader
+{
+	framelog::FrameType type = framelog::FrameType::Keyframe;
+	std::uint16_t runCount        = 0; // Delta frames only
+	std::uint32_t payloadSize     = 0; // Bytes following this header, multiple of 8
+	std::uint64_t timestampMicros = 0; // Since the recording started
+};
+
+struct FrameLogRun
+{
+	std::uint32_t start = 0; // First cell index
+	std::uint32_t count = 0; // Number of cells in the run
+};
+
+struct FrameLogIndexEntry
+{
+	std::uint64_t offset          = 0; // File offset of the FrameLogFrameHeader
+	std::uint64_t timestampMicros = 0;
+	std::uint32_t keyframe        = 0; // Index of the closest keyframe at or before this frame
+	std::uint32_t reserved        = 0;
+};
+
+struct FrameLogTrailer
+{
+	std::uint64_t indexOffset = 0;
+	std::uint32_t frameCount  = 0;
+	std::uint32_t magic       = framelog::TrailerMagic;
+};
+
+static_assert(sizeof(FrameLogHeader)      == 16, "Unexpected FrameLogHeader size");
+static_assert(sizeof(FrameLogFrameHeader) == 16, "Unexpected FrameLogFrameHeader size");
+static_assert(sizeof(FrameLogRun)         == 8,  "Unexpected FrameLogRun size");
+static_assert(sizeof(FrameLogIndexEntry)  == 24, "Unexpected FrameLogIndexEntry size");
+static_assert(sizeof(FrameLogTrailer)     == 16, "Unexpected FrameLogTrailer size");
+
+// Streams presented frames to a file, delta-encoded against the previous frame.
+class FrameWriter final
+{
+public:
+
+	FrameWriter() = default;
+	~FrameWriter();
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	// A keyframe is forced every keyframeInterval frames (and for the first frame).
+	bool Open(const char* filename, const int width, const int height, const int keyframeInterval);
+
+	// Writes the index and trailer, then closes the file.
+	void Close();
+
+	bool IsOpen() const { return m_file != nullptr; }
+
+	int Width()  const { return m_width;  }
+	int Height() const { return m_height; }
+
+	// cells must hold width*height entries.
+	void WriteFrame(const FrameCell* cells, const std::uint64_t timestampMicros);
+
+private:
+
+	void BeginFrame(const framelog::FrameType type, const std::uint16_t runCount, const std::uint32_t payloadSize, const std::uint64_t timestampMicros);
+	void Write(const void* data, const std::size_t size);
+	void Flush();
+
+	void*         m_file             = nullptr; // Win32 HANDLE
+	std::uint64_t m_offset           = 0;
+	int           m_width            = 0;
+	int           m_height           = 0;
+	int           m_keyframeInterval = 0;
+	std::uint32_t m_lastKeyframe     = 0;
+
+	std::vector<std::uint8_t>       m_buffer; // Staging buffer, flushed in large blocks
+	std::vector<FrameCell>          m_previous;
+	std::vector<FrameLogRun>        m_runs;
+	std::vector<FrameLogIndexEntry> m_index;
+};
+
+// Memory-maps a frame log and decodes frames on demand, with random access
+// through the keyframe index.
+class FrameReader final
+{
+public:
+
+	FrameReader() = default;
+	~FrameReader();
+
+	FrameReader(const FrameReader&) = delete;
+	FrameReader& operator=(const FrameReader&) = delete;
+
+	bool Open(const char* filename);
+	void Close();
+
+	int Width()  const { return m_header.width;  }
+	int Height() const { return m_header.height; }
+
+	std::uint32_t FrameCount() const { return static_cast<std::uint32_t>(m_index.size()); }
+	std::uint64_t FrameTimestamp(const std::uint32_t frame) const { return m_index[frame].timestampMicros; }
+
+	// Decodes the given frame into Cells(). Sequential reads apply a single delta;
+	// random access restarts from the closest keyframe.
+	bool ReadFrame(const std::uint32_t frame);
+
+	const FrameCell* Cells() const { return m_cells.data(); }
+
+	// Size in bytes of the mapped file.
+	std::uint64_t FileSize() const { return m_size; }
+
+private:
+
+	bool BuildIndex();
+	bool IndexIsValid() const;
+	bool DecodeFrame(const std::uint32_t frame);
+
+	void*                 m_file    = nullptr; // Win32 HANDLEs
+	void*                 m_mapping = nullptr;
+	const std::uint8_t*   m_data    = nullptr;
+	std::uint64_t         m_size    = 0;
+	FrameLogHeader        m_header;
+	std::int64_t          m_current = -1;
+
+	std::vector<FrameCell>          m_cells;
+	std::vector<FrameLogIndexEntry> m_index;
+};
+
+} // namespace console
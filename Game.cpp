@@ -0,0 +1,155 @@
+#include "Game.h"
+
+#include <cassert>
+
+namespace game
+{
+
+Random::Random(std::uint64_t seed)
+{
+	// Run the seed through splitmix64 so that consecutive seeds
+	// (e.g. thread indices) give uncorrelated sequences. State must never be zero.
+	seed += 0x9E3779B97F4A7C15ull;
+	seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+	seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+	seed = seed ^ (seed >> 31);
+
+	m_state = (seed != 0) ? seed : 0x2545F4914F6CDD1Dull;
+}
+
+std::uint64_t Random::Next()
+{
+	m_state ^= m_state >> 12;
+	m_state ^= m_state << 25;
+	m_state ^= m_state >> 27;
+	return m_state * 0x2545F4914F6CDD1Dull;
+}
+
+std::uint32_t Random::NextBelow(std::uint32_t bound)
+{
+	assert(bound != 0);
+
+	// Multiply-shift range reduction; the bias is negligible for the tiny bounds we use.
+	const auto r = static_cast<std::uint32_t>(Next() >> 32);
+	return static_cast<std::uint32_t>((static_cast<std::uint64_t>(r) * bound) >> 32);
+}
+
+void Board::Reset()
+{
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 3; column++)
+		{
+			cells[row][column] = EmptyCell;
+		}
+	}
+}
+
+bool Board::IsValidMove(const Move& move) const
+{
+	if (move.row < 0 || move.row > 2 || move.column < 0 || move.column > 2)
+	{
+		return false;
+	}
+
+	return cells[move.row][move.column] == EmptyCell;
+}
+
+bool Board::IsFull() const
+{
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 3; column++)
+		{
+			if (cells[row][column] == EmptyCell)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool Board::HasLine(const char ch) const
+{
+	for (int i = 0; i < 3; i++)
+	{
+		// Horizontal lines
+		if ((cells[i][0] == ch) && (cells[i][1] == ch) && (cells[i][2] == ch))
+		{
+			return true;
+		}
+		// Vertical lines
+		if ((cells[0][i] == ch) && (cells[1][i] == ch) && (cells[2][i] == ch))
+		{
+			return true;
+		}
+	}
+
+	// Diagonals
+	if ((cells[0][0] == ch) && (cells[1][1] == ch) && (cells[2][2] == ch))
+	{
+		return true;
+	}
+	if ((cells[0][2] == ch) && (cells[1][1] == ch) && (cells[2][0] == ch))
+	{
+		return true;
+	}
+
+	return false;
+}
+
+bool Board::Play(const Move& move, const char ch)
+{
+	if (!IsValidMove(move))
+	{
+		return false;
+	}
+
+	cells[move.row][move.column] = ch;
+	return true;
+}
+
+Outcome Board::Evaluate() const
+{
+	if (HasLine(PlayerCharacter))
+	{
+		return Outcome::PlayerWins;
+	}
+
+	if (HasLine(AICharacter))
+	{
+		return Outcome::AIWins;
+	}
+
+	return IsFull() ? Outcome::Tie : Outcome::InProgress;
+}
+
+Move ChooseAIMove(const Board& board, Random& random)
+{
+	// Gather the empty cells and pick one uniformly. Unlike retrying random
+	// cells until an empty one is hit, this always terminates, even on a full board.
+	Move candidates[9];
+	std::uint32_t count = 0;
+
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 3; column++)
+		{
+			if (board.cells[row][column] == EmptyCell)
+			{
+				candidates[count++] = Move{ row, column };
+			}
+		}
+	}
+
+	if (count == 0)
+	{
+		return Move{};
+	}
+
+	return candidates[random.NextBelow(count)];
+}
+
+} // namespace game
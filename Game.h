@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+namespace game
+{
+
+// Tic-Tac-Toe rules and AI, free of any console or stdio dependencies
+// so they can be driven by the interactive demo or by the headless self-play harness.
+
+constexpr char EmptyCell       = ' ';
+constexpr char PlayerCharacter = 'X';
+constexpr char AICharacter     = 'O';
+
+enum class Outcome : std::uint8_t
+{
+	InProgress,
+	PlayerWins,
+	AIWins,
+	Tie,
+};
+
+struct Move
+{
+	int row    = -1;
+	int column = -1;
+};
+
+// Small and fast xorshift64* generator. Each thread/game owns its own instance,
+// so there's no shared state like with std::rand().
+class Random final
+{
+public:
+
+	explicit Random(std::uint64_t seed);
+
+	std::uint64_t Next();
+
+	// Uniform integer in the range [0, bound).
+	std::uint32_t NextBelow(std::uint32_t bound);
+
+private:
+
+	std::uint64_t m_state;
+};
+
+struct Board
+{
+	char cells[3][3] = {
+		{ EmptyCell, EmptyCell, EmptyCell },
+		{ EmptyCell, EmptyCell, EmptyCell },
+		{ EmptyCell, EmptyCell, EmptyCell },
+	};
+
+	void Reset();
+
+	bool IsValidMove(const Move& move) const;
+	bool IsFull() const;
+	bool HasLine(const char ch) const;
+
+	// Places the character if the move is valid. Returns false otherwise.
+	bool Play(const Move& move, const char ch);
+
+	// Player wins take precedence over AI wins, then tie if the board is full.
+	Outcome Evaluate() const;
+};
+
+// Very simple "random" AI: just selects any empty cell to make its move.
+// Returns a move with row/column = -1 if the board is full.
+Move ChooseAIMove(const Board& board, Random& random);
+
+} // namespace game
@@ -1,10 +1,35 @@
 #include "Screen.h"
-#include <cassert>
-#include <sstream>
+#include "FrameLog.h"
+#include "OutputSink.h"
+#include "AllocationCounter.h"
+#include "Widgets.h"
+#include "Game.h"
+#include "SelfPlay.h"
+#include "VtEncoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <cstdio>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <vector>
 using namespace console;
 
-void DrawTicTacToeBoard(Screen& screen, const int x, const int y, const char boardValues[3][3], const Colour boardColours[3][3])
+Colour CellColour(const char value)
+{
+	switch (value)
+	{
+	case game::PlayerCharacter : return Colour::BrightRed;
+	case game::AICharacter     : return Colour::BrightBlue;
+	default                    : return Colour::White;
+	}
+}
+
+void DrawTicTacToeBoard(Screen& screen, const int x, const int y, const char boardValues[3][3])
 {
 	// Top-side numbers
 	screen.DrawChar('0', Point{ x + 2,  y }, Colour::White, Colour::Black);
@@ -28,170 +53,556 @@ void DrawTicTacToeBoard(Screen& screen, const int x, const int y, const char boa
 	screen.DrawLine(Line{ { x + 1, y + 5 }, { x + 12, y + 5 }, LineStyle::Double }, Colour::White, Colour::Black);
 
 	// Row[0] (top)
-	screen.DrawChar(boardValues[0][0], Point{ x + 2,  y + 2 }, boardColours[0][0], Colour::Black);
-	screen.DrawChar(boardValues[0][1], Point{ x + 6,  y + 2 }, boardColours[0][1], Colour::Black);
-	screen.DrawChar(boardValues[0][2], Point{ x + 10, y + 2 }, boardColours[0][2], Colour::Black);
+	screen.DrawChar(boardValues[0][0], Point{ x + 2,  y + 2 }, CellColour(boardValues[0][0]), Colour::Black);
+	screen.DrawChar(boardValues[0][1], Point{ x + 6,  y + 2 }, CellColour(boardValues[0][1]), Colour::Black);
+	screen.DrawChar(boardValues[0][2], Point{ x + 10, y + 2 }, CellColour(boardValues[0][2]), Colour::Black);
 
 	// Row[1] (middle)
-	screen.DrawChar(boardValues[1][0], Point{ x + 2,  y + 4 }, boardColours[1][0], Colour::Black);
-	screen.DrawChar(boardValues[1][1], Point{ x + 6,  y + 4 }, boardColours[1][1], Colour::Black);
-	screen.DrawChar(boardValues[1][2], Point{ x + 10, y + 4 }, boardColours[1][2], Colour::Black);
+	screen.DrawChar(boardValues[1][0], Point{ x + 2,  y + 4 }, CellColour(boardValues[1][0]), Colour::Black);
+	screen.DrawChar(boardValues[1][1], Point{ x + 6,  y + 4 }, CellColour(boardValues[1][1]), Colour::Black);
+	screen.DrawChar(boardValues[1][2], Point{ x + 10, y + 4 }, CellColour(boardValues[1][2]), Colour::Black);
 
 	// Row[2] (bottom)
-	screen.DrawChar(boardValues[2][0], Point{ x + 2,  y + 6 }, boardColours[2][0], Colour::Black);
-	screen.DrawChar(boardValues[2][1], Point{ x + 6,  y + 6 }, boardColours[2][1], Colour::Black);
-	screen.DrawChar(boardValues[2][2], Point{ x + 10, y + 6 }, boardColours[2][2], Colour::Black);
+	screen.DrawChar(boardValues[2][0], Point{ x + 2,  y + 6 }, CellColour(boardValues[2][0]), Colour::Black);
+	screen.DrawChar(boardValues[2][1], Point{ x + 6,  y + 6 }, CellColour(boardValues[2][1]), Colour::Black);
+	screen.DrawChar(boardValues[2][2], Point{ x + 10, y + 6 }, CellColour(boardValues[2][2]), Colour::Black);
 }
 
-int main()
+// The game board as a widget: only redrawn when a move changed it.
+class BoardWidget final : public ui::Widget
 {
-	Screen screen{ "Console Tic-Tac-Toe", 64, 32 };
+public:
 
-	bool playerMoveIsValid = false;
-	int playerMoveRow = -1, playerMoveColumn = -1;
+	void SetCells(const char cells[3][3])
+	{
+		if (std::memcmp(m_cells, cells, sizeof(m_cells)) == 0)
+		{
+			return;
+		}
 
-	const char playerCharacter = 'X';
-	const char aiCharacter = 'O';
+		std::memcpy(m_cells, cells, sizeof(m_cells));
+		Invalidate();
+	}
 
-	// 0=player, 1=AI
-	bool winner[2] = { false, false };
+protected:
 
-	// Blank space = empty
-	char boardValues[3][3] = {
-		{ ' ', ' ', ' ' },
-		{ ' ', ' ', ' ' },
-		{ ' ', ' ', ' ' },
-	};
+	// Same extent as DrawTicTacToeBoard: the numbers on the right and the 8 rows of the outline.
+	ui::Size MeasureContent() const override { return ui::Size{ 15, 8 }; }
 
-	Colour boardColours[3][3] = {};
+	void Paint(Screen& screen) const override
+	{
+		DrawTicTacToeBoard(screen, Bounds().x, Bounds().y, m_cells);
+	}
 
-	for (;;)
+private:
+
+	char m_cells[3][3] = {};
+};
+
+// Usage: ConsoleDemo --selfplay [games] [threads] [seed]
+int SelfPlayMain(int argc, char* argv[])
+{
+	game::SelfPlaySettings settings;
+
+	if (argc > 2) { settings.games   = std::strtoull(argv[2], nullptr, 10); }
+	if (argc > 3) { settings.threads = static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)); }
+	if (argc > 4) { settings.seed    = std::strtoull(argv[4], nullptr, 10); }
+
+	const game::SelfPlayResults results = game::RunSelfPlay(settings);
+	game::PrintSelfPlayResults(results);
+
+	return 0;
+}
+
+// Usage: ConsoleDemo --replay <file> [--realtime]
+// Pushes every recorded frame through the Screen, as fast as possible by default.
+int ReplayMain(int argc, char* argv[])
+{
+	if (argc < 3)
 	{
-		if (playerMoveIsValid)
+		std::cerr << "Missing frame log file name.\n";
+		return 1;
+	}
+
+	FrameReader reader;
+	if (!reader.Open(argv[2]))
+	{
+		std::cerr << "Failed to open frame log '" << argv[2] << "'.\n";
+		return 1;
+	}
+
+	const bool realtime = (argc > 3 && std::strcmp(argv[3], "--realtime") == 0);
+
+	Screen screen{ "Console Replay", reader.Width(), reader.Height() };
+
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	for (std::uint32_t frame = 0; frame < reader.FrameCount(); ++frame)
+	{
+		if (!reader.ReadFrame(frame))
 		{
-			std::cout << "AI makes a move...\n";
-			console::Wait(1500);
+			std::cerr << "Corrupted frame " << frame << ".\n";
+			return 1;
+		}
 
-			// Set player move
-			boardValues[playerMoveRow][playerMoveColumn]  = playerCharacter;
-			boardColours[playerMoveRow][playerMoveColumn] = Colour::BrightRed;
+		if (realtime)
+		{
+			std::this_thread::sleep_until(start + std::chrono::microseconds(reader.FrameTimestamp(frame)));
+		}
+
+		screen.PresentCells(reader.Cells(), reader.Width(), reader.Height());
+	}
+
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	const double cells = static_cast<double>(reader.FrameCount()) * reader.Width() * reader.Height();
+
+	std::cout << "Replayed " << reader.FrameCount() << " frames (" << reader.FileSize() << " bytes) in " << seconds << " s: "
+	          << (reader.FrameCount() / seconds) << " frames/s, " << (cells / seconds) << " cells/s\n";
+
+	return 0;
+}
+
+// Discards everything, to exercise the sink encoding path without any I/O.
+class NullSink final : public OutputSink
+{
+public:
+
+	SinkStatus Write(const std::uint8_t*, const std::size_t) override { return SinkStatus::Ok; }
+};
+
+// Usage: ConsoleDemo --alloc-check [frames]
+// Draws and presents frames in a loop and fails if anything allocates after the first frame.
+int AllocCheckMain(int argc, char* argv[])
+{
+	const int frames = (argc > 2) ? std::atoi(argv[2]) : 1000;
+
+	Screen screen{ "Console Allocation Check", 64, 32 };
+	screen.AddSink(std::make_shared<NullSink>());
+
+	SetAllocationCounting(true);
+
+	std::uint64_t steadyStateAllocations = 0;
+
+	for (int frame = 0; frame <= frames; ++frame)
+	{
+		const std::uint64_t before = AllocationCount();
 
-			// Very simple "random" AI: just selects randomly any empty cell to make its move
-			bool aiMadeValidMove = false;
-			while (!aiMadeValidMove)
+		char text[32];
+		std::snprintf(text, sizeof(text), "Frame %d", frame);
+
+		screen.Clear();
+		DrawDemo(screen);
+		screen.Scroll(Point{ 0, 26 }, screen.Width(), 4, 1, Colour::Black);
+		screen.DrawText(std::string_view{ text }, Point{ 2, 29 }, Colour::White, Colour::DarkBlue);
+		screen.Present();
+
+		// Frame 0 is allowed to size the buffers.
+		if (frame > 0)
+		{
+			steadyStateAllocations += AllocationCount() - before;
+		}
+	}
+
+	SetAllocationCounting(false);
+
+	std::cout << steadyStateAllocations << " allocations in " << frames << " steady-state frames.\n";
+	return (steadyStateAllocations == 0) ? 0 : 1;
+}
+
+// Usage: ConsoleDemo --dashboard [frames]
+// A ~500 widget dashboard where a few widgets change every frame. Compares rendering
+// only what changed against repainting every widget each frame.
+int DashboardMain(int argc, char* argv[])
+{
+	const int frames = (argc > 2) ? std::max(std::atoi(argv[2]), 1) : 1000;
+
+	constexpr int TileRows    = 14;
+	constexpr int TileColumns = 12;
+	constexpr int TableRows   = 20;
+	constexpr int UpdatesPerFrame = 8;
+
+	Screen screen{ "Console Dashboard", 160, 50 };
+	screen.SetFollowWindowSize(true);
+	ui::WidgetTree widgets{ screen };
+
+	struct Tile
+	{
+		ui::Label*       label = nullptr;
+		ui::ProgressBar* bar   = nullptr;
+	};
+	std::vector<Tile> tiles;
+
+	ui::Widget& root = widgets.Root();
+	int widgetCount = 1;
+
+	ui::LayoutStyle headerStyle;
+	headerStyle.height = 1;
+	auto& header = root.Add<ui::Label>("Dashboard", Colour::White);
+	header.SetStyle(headerStyle);
+	header.SetBackground(Colour::DarkBlue);
+
+	ui::LayoutStyle bodyStyle;
+	bodyStyle.grow      = 1;
+	bodyStyle.direction = ui::Direction::Row;
+	bodyStyle.gap       = 1;
+	auto& body = root.Add<ui::Widget>();
+	body.SetStyle(bodyStyle);
+	widgetCount += 2;
+
+	ui::LayoutStyle gridStyle;
+	gridStyle.grow = 1;
+	gridStyle.gap  = 1;
+	auto& grid = body.Add<ui::Widget>();
+	grid.SetStyle(gridStyle);
+	++widgetCount;
+
+	ui::LayoutStyle rowStyle;
+	rowStyle.direction = ui::Direction::Row;
+	rowStyle.gap       = 1;
+
+	ui::LayoutStyle tileStyle;
+	tileStyle.grow = 1;
+
+	for (int row = 0; row < TileRows; ++row)
+	{
+		auto& tileRow = grid.Add<ui::Widget>();
+		tileRow.SetStyle(rowStyle);
+		++widgetCount;
+
+		for (int column = 0; column < TileColumns; ++column)
+		{
+			auto& tile = tileRow.Add<ui::Widget>();
+			tile.SetStyle(tileStyle);
+			tile.SetBackground(Colour::DarkBlue);
+
+			Tile entry;
+			entry.label = &tile.Add<ui::Label>("--", Colour::White);
+			entry.label->SetBackground(Colour::DarkBlue);
+			entry.bar = &tile.Add<ui::ProgressBar>(Colour::BrightGreen, Colour::Gray);
+			tiles.push_back(entry);
+			widgetCount += 3;
+		}
+	}
+
+	ui::LayoutStyle sideStyle;
+	sideStyle.width = 34;
+	sideStyle.gap   = 1;
+	auto& side = body.Add<ui::Panel>("Processes", LineStyle::Double);
+	side.SetStyle(sideStyle);
+
+	auto& table = side.Add<ui::Table>();
+	table.AddColumn("PID", 6);
+	table.AddColumn("Name", 14);
+	table.AddColumn("CPU", 6);
+	table.SetRowCount(TableRows);
+
+	auto& board = side.Add<BoardWidget>();
+	widgetCount += 3;
+
+	game::Board gameBoard;
+	game::Random random{ 1 };
+
+	using Clock = std::chrono::steady_clock;
+	char text[32];
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		const bool repaintAll = (pass == 1);
+		long long paintedWidgets = 0;
+		Clock::duration elapsed{};
+
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			// Same data changes in both passes.
+			for (int update = 0; update < UpdatesPerFrame; ++update)
 			{
-				int aiMoveRow    = std::rand() % 3;
-				int aiMoveColumn = std::rand() % 3;
+				Tile& tile = tiles[random.NextBelow(static_cast<std::uint32_t>(tiles.size()))];
+				const int percent = static_cast<int>(random.NextBelow(101));
 
-				assert(aiMoveRow    <= 2);
-				assert(aiMoveColumn <= 2);
+				std::snprintf(text, sizeof(text), "cpu %3d%%", percent);
+				tile.label->SetText(text);
+				tile.bar->SetValue(static_cast<float>(percent) / 100.0f);
+			}
 
-				if (boardValues[aiMoveRow][aiMoveColumn] == ' ')
+			const int row = static_cast<int>(random.NextBelow(TableRows));
+			std::snprintf(text, sizeof(text), "%d", 1000 + row);
+			table.SetCell(row, 0, text);
+			std::snprintf(text, sizeof(text), "worker-%d", row);
+			table.SetCell(row, 1, text);
+			std::snprintf(text, sizeof(text), "%u%%", random.NextBelow(101));
+			table.SetCell(row, 2, text);
+
+			if (frame % 30 == 0)
+			{
+				if (gameBoard.IsFull() || gameBoard.Evaluate() != game::Outcome::InProgress)
 				{
-					boardValues[aiMoveRow][aiMoveColumn]  = aiCharacter;
-					boardColours[aiMoveRow][aiMoveColumn] = Colour::BrightBlue;
-					aiMadeValidMove = true;
+					gameBoard.Reset();
 				}
+				gameBoard.Play(game::ChooseAIMove(gameBoard, random), (frame % 60 == 0) ? game::PlayerCharacter : game::AICharacter);
+				board.SetCells(gameBoard.cells);
+			}
+
+			if (repaintAll)
+			{
+				widgets.InvalidateAll();
 			}
 
-			// 0=player, 1=AI
-			const char charsToCheck[2] = { playerCharacter, aiCharacter };
+			const auto start = Clock::now();
+			widgets.Render();
+			elapsed += Clock::now() - start;
+
+			paintedWidgets += widgets.LastPaintCount();
+		}
+
+		const double micros = std::chrono::duration<double, std::micro>(elapsed).count() / frames;
+
+		std::printf("%-12s %8.1f widgets/frame  %10.1f us/frame\n",
+			repaintAll ? "Full redraw:" : "Retained:",
+			static_cast<double>(paintedWidgets) / frames, micros);
+	}
+
+	std::printf("%d widgets, %d frames, %d tile updates per frame.\n", widgetCount, frames, UpdatesPerFrame);
+	return 0;
+}
+
+// Usage: ConsoleDemo --bench-encode [frames] [width] [height] [max threads]
+// Times the VT encoding of full repaints and of scene switches (every cell changed) for
+// 1, 2, 4... threads up to the core count, and checks the output against the serial encoder.
+int EncodeBenchMain(int argc, char* argv[])
+{
+	const int frames = (argc > 2) ? std::max(std::atoi(argv[2]), 1) : 200;
+	const int width  = (argc > 3) ? std::max(std::atoi(argv[3]), 1) : 240;
+	const int height = (argc > 4) ? std::max(std::atoi(argv[4]), 1) : 80;
+
+	const unsigned maxThreads = (argc > 5) ? static_cast<unsigned>(std::max(std::atoi(argv[5]), 1)) : std::max(1u, std::thread::hardware_concurrency());
+
+	const std::size_t cellCount = static_cast<std::size_t>(width) * height;
+
+	// Two unrelated scenes of random text and colours, so that nearly every cell needs an SGR.
+	static constexpr std::uint16_t glyphs[] = { 'a', 'Z', '7', '#', 0x2500, 0x2551, 0x2592, 0x00E9, 0x03C0 };
+
+	game::Random random{ 1 };
+	std::vector<FrameCell> scenes[2];
+	for (std::vector<FrameCell>& scene : scenes)
+	{
+		scene.resize(cellCount);
+		for (FrameCell& cell : scene)
+		{
+			cell.ch      = glyphs[random.NextBelow(static_cast<std::uint32_t>(std::size(glyphs)))];
+			cell.attribs = static_cast<std::uint16_t>(random.NextBelow(256));
+		}
+	}
+
+	// Serial output, as the reference.
+	std::vector<std::uint8_t> expected[2];
+	EncodeVtFrame(scenes[0].data(), nullptr, width, height, expected[0]);
+	EncodeVtFrame(scenes[1].data(), scenes[0].data(), width, height, expected[1]);
 
-			// Check if there is a winner
-			for (int j = 0; j < 2; j++)
+	std::vector<std::uint8_t> out;
+	out.reserve(std::max(expected[0].size(), expected[1].size()));
+
+	std::printf("%d x %d cells, %d frames, full repaint %zu bytes, scene switch %zu bytes\n",
+		width, height, frames, expected[0].size(), expected[1].size());
+	std::printf("%-8s %16s %16s %9s\n", "Threads", "Repaint us", "Switch us", "Speedup");
+
+	using Clock = std::chrono::steady_clock;
+	double serialMicros = 0.0;
+
+	// 1, 2, 4... threads, then the maximum.
+	for (unsigned step = 1; ; step *= 2)
+	{
+		const unsigned threads = std::min(step, maxThreads);
+		VtParallelEncoder encoder{ threads };
+		double micros[2] = {};
+
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			const FrameCell* previous = (pass == 0) ? nullptr : scenes[0].data();
+			Clock::duration elapsed{};
+
+			for (int frame = 0; frame < frames; ++frame)
 			{
-				for (int i = 0; i < 3; i++)
-				{
-					// Vertical lines
-					if ((boardValues[i][0] == charsToCheck[j]) && (boardValues[i][1] == charsToCheck[j]) && (boardValues[i][2] == charsToCheck[j]))
-					{
-						winner[j] = true;
-					}
-					// Horizontal lines
-					if ((boardValues[0][i] == charsToCheck[j]) && (boardValues[1][i] == charsToCheck[j]) && (boardValues[2][i] == charsToCheck[j]))
-					{
-						winner[j] = true;
-					}
-				}
+				out.clear();
 
-				// Diagonals
-				if ((boardValues[0][0] == charsToCheck[j]) && (boardValues[1][1] == charsToCheck[j]) && (boardValues[2][2] == charsToCheck[j]))
-				{
-					winner[j] = true;
-				}
-				if ((boardValues[0][2] == charsToCheck[j]) && (boardValues[1][1] == charsToCheck[j]) && (boardValues[2][0] == charsToCheck[j]))
-				{
-					winner[j] = true;
-				}
+				const auto start = Clock::now();
+				encoder.Encode(scenes[pass].data(), previous, width, height, out);
+				elapsed += Clock::now() - start;
+			}
 
-				// We can early out if player or AI won
-				if (winner[j])
-				{
-					break;
-				}
+			if (out != expected[pass])
+			{
+				std::printf("Output of %u threads differs from the serial encoder.\n", threads);
+				return 1;
 			}
+
+			micros[pass] = std::chrono::duration<double, std::micro>(elapsed).count() / frames;
 		}
 
-		screen.Clear();
+		if (threads == 1)
+		{
+			serialMicros = micros[0];
+		}
 
-		// Draw and display the board
-		DrawTicTacToeBoard(screen, 1, 7, boardValues, boardColours);
-		screen.Present();
+		std::printf("%-8u %16.1f %16.1f %8.2fx\n", threads, micros[0], micros[1], serialMicros / micros[0]);
 
-		bool restartGame = false;
-		if (winner[0]) // player won
+		if (threads == maxThreads)
 		{
-			std::cout << "CONGRATULATION, YOU WON!\n";
-			console::Wait(1500);
-			restartGame = true;
+			break;
 		}
-		else if (winner[1]) // ai won
+	}
+
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::strcmp(argv[1], "--alloc-check") == 0)
+	{
+		return AllocCheckMain(argc, argv);
+	}
+
+	if (argc > 1 && std::strcmp(argv[1], "--dashboard") == 0)
+	{
+		return DashboardMain(argc, argv);
+	}
+
+	if (argc > 1 && std::strcmp(argv[1], "--selfplay") == 0)
+	{
+		return SelfPlayMain(argc, argv);
+	}
+
+	if (argc > 1 && std::strcmp(argv[1], "--replay") == 0)
+	{
+		return ReplayMain(argc, argv);
+	}
+
+	if (argc > 1 && std::strcmp(argv[1], "--bench-encode") == 0)
+	{
+		return EncodeBenchMain(argc, argv);
+	}
+
+	Screen screen{ "Console Tic-Tac-Toe", 64, 32 };
+	screen.SetFollowWindowSize(true);
+
+	// Usage: ConsoleDemo [--record <file>] [--mirror-file <file>]... [--mirror-pipe <name>]... [--encode-threads <count>]
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const char* option = argv[i];
+		const char* value  = argv[i + 1];
+
+		if (std::strcmp(option, "--record") == 0)
 		{
-			std::cout << "AI WINS!\n";
-			console::Wait(1500);
-			restartGame = true;
+			if (!screen.StartRecording(value))
+			{
+				std::cerr << "Failed to create frame log '" << value << "'.\n";
+				return 1;
+			}
 		}
-		else // check for tie
+		else if (std::strcmp(option, "--mirror-file") == 0)
 		{
-			bool hasEmptyCell = false;
-			for (int x = 0; x < 3; x++)
+			auto sink = std::make_shared<FileSink>(value);
+			if (!sink->IsOpen())
 			{
-				for (int y = 0; y < 3; y++)
-				{
-					if (boardValues[x][y] == ' ')
-					{
-						hasEmptyCell = true;
-						break;
-					}
-				}
+				std::cerr << "Failed to create mirror file '" << value << "'.\n";
+				return 1;
 			}
+			screen.AddSink(sink);
+		}
+		else if (std::strcmp(option, "--mirror-pipe") == 0)
+		{
+			auto sink = std::make_shared<PipeSink>(value);
+			if (!sink->IsOpen())
+			{
+				std::cerr << "Failed to create pipe '" << value << "'.\n";
+				return 1;
+			}
+			screen.AddSink(sink);
+		}
+		else if (std::strcmp(option, "--encode-threads") == 0)
+		{
+			screen.SetEncodeThreads(static_cast<unsigned>(std::strtoul(value, nullptr, 10)));
+		}
+	}
+
+	// Board at (1, 7), below the prompts printed through stdout.
+	ui::WidgetTree widgets{ screen };
+
+	ui::LayoutStyle rootStyle;
+	rootStyle.padding = 1;
+	rootStyle.align   = ui::Align::Start;
+	widgets.Root().SetStyle(rootStyle);
+
+	ui::LayoutStyle spacerStyle;
+	spacerStyle.height = 6;
+	widgets.Root().Add<ui::Widget>().SetStyle(spacerStyle);
+
+	auto& boardWidget = widgets.Root().Add<BoardWidget>();
+
+	bool playerMoveIsValid = false;
+	game::Move playerMove;
+
+	game::Board board;
+	game::Random random{ static_cast<std::uint64_t>(std::time(nullptr)) };
+
+	for (;;)
+	{
+		game::Outcome outcome = game::Outcome::InProgress;
+
+		if (playerMoveIsValid)
+		{
+			// Set player move
+			board.Play(playerMove, game::PlayerCharacter);
+			outcome = board.Evaluate();
 
-			if (!hasEmptyCell)
+			// AI only gets a turn if the player's move didn't end the game
+			if (outcome == game::Outcome::InProgress)
 			{
-				std::cout << "TIE GAME!\n";
+				std::cout << "AI makes a move...\n";
 				console::Wait(1500);
-				restartGame = true;
+
+				const game::Move aiMove = game::ChooseAIMove(board, random);
+				board.Play(aiMove, game::AICharacter);
+				outcome = board.Evaluate();
 			}
 		}
 
+		// Clear() also wipes what stdout printed, so the widgets have to be repainted.
+		screen.Clear();
+		widgets.InvalidateAll();
+
+		// Draw and display the board
+		boardWidget.SetCells(board.cells);
+		widgets.Render();
+
+		bool restartGame = true;
+		switch (outcome)
+		{
+		case game::Outcome::PlayerWins:
+			std::cout << "CONGRATULATION, YOU WON!\n";
+			break;
+
+		case game::Outcome::AIWins:
+			std::cout << "AI WINS!\n";
+			break;
+
+		case game::Outcome::Tie:
+			std::cout << "TIE GAME!\n";
+			break;
+
+		default:
+			restartGame = false;
+			break;
+		}
+
 		if (restartGame)
 		{
+			console::Wait(1500);
+
 			// Restart the game once the player or AI have won (reset all states)
 			playerMoveIsValid = false;
-			playerMoveRow = -1;
-			playerMoveColumn = -1;
-
-			winner[0] = false;
-			winner[1] = false;
-
-			for (int x = 0; x < 3; x++)
-			{
-				for (int y = 0; y < 3; y++)
-				{
-					boardValues[x][y]  = ' ';
-					boardColours[x][y] = Colour::White;
-				}
-			}
+			playerMove = {};
+			board.Reset();
 		}
 
 		// Header text
@@ -199,48 +610,62 @@ int main()
 		             "(separated by a comma, e.g.: 0,1) or 'exit' to quit.\n\n";
 		std::cout << "> ";
 
-		// Wait for user input
-		std::string input;
-		std::cin >> input;
+		// Wait for user input (fixed size buffer, so there's nothing to allocate per turn)
+		char input[32] = {};
+		std::cin >> std::setw(static_cast<int>(sizeof(input))) >> input;
 
 		// Quit if "exit" was typed
-		if (input == "exit")
+		if (!std::cin || std::strcmp(input, "exit") == 0)
 		{
 			break;
 		}
 
-		// Parse the row and column number entered by the user
+		// Parse the row and column number entered by the user.
+		// Anything missing or out of range stays -1 and fails validation below.
 		int inputRowAndColumn[2] = { -1, -1 };
-		std::stringstream parser{ input };
+		const char* cursor = input;
 
-		for (int i = 0; (i < 2 && parser.good()); ++i)
+		for (int i = 0; i < 2; ++i)
 		{
-			std::string subString;
-			std::getline(parser, subString, ',');
+			char* end = nullptr;
+			const long value = std::strtol(cursor, &end, 10);
+
+			if (end == cursor)
+			{
+				break;
+			}
 
-			try {
-				inputRowAndColumn[i] = std::stoi(subString);
+			inputRowAndColumn[i] = (value >= 0 && value <= 2) ? static_cast<int>(value) : -1;
+
+			if (*end != ',')
+			{
+				break;
 			}
-			catch (...) {}
+			cursor = end + 1;
 		}
 
-		playerMoveRow    = inputRowAndColumn[0];
-		playerMoveColumn = inputRowAndColumn[1];
+		playerMove.row    = inputRowAndColumn[0];
+		playerMove.column = inputRowAndColumn[1];
 
 		// Validate the inputs
-		if (playerMoveRow < 0 || playerMoveRow > 2)
+		if (playerMove.row < 0 || playerMove.row > 2)
 		{
 			std::cout << "Invalid row! Try again.\n";
 			playerMoveIsValid = false;
 		}
-		else if (playerMoveColumn < 0 || playerMoveColumn > 2)
+		else if (playerMove.column < 0 || playerMove.column > 2)
 		{
 			std::cout << "Invalid column! Try again.\n";
 			playerMoveIsValid = false;
 		}
+		else if (!board.IsValidMove(playerMove))
+		{
+			std::cout << "Cell already taken! Try again.\n";
+			playerMoveIsValid = false;
+		}
 		else
 		{
-			std::cout << "Your move is: " << playerMoveRow << "," << playerMoveColumn << "\n";
+			std::cout << "Your move is: " << playerMove.row << "," << playerMove.column << "\n";
 			playerMoveIsValid = true;
 		}
 
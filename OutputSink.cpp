@@ -0,0 +1,556 @@
+#include "OutputSink.h"
+
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define NOUSER   // Suppress DrawTextA|W macro
+#define NOGDI    // Suppress Rectangle() function
+#define NOMINMAX // Suppress min/max macros
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+namespace console
+{
+
+namespace
+{
+
+// Writes everything or fails. WriteFile may return short counts on pipes.
+bool WriteAll(HANDLE handle, const std::uint8_t* data, std::size_t size)
+{
+	while (size > 0)
+	{
+		const DWORD chunk = static_cast<DWORD>(size < 0x40000000 ? size : 0x40000000);
+		DWORD written = 0;
+
+		if (!WriteFile(handle, data, chunk, &written, nullptr) || written == 0)
+		{
+			return false;
+		}
+
+		data += written;
+		size -= written;
+	}
+
+	return true;
+}
+
+// Fixed capacity FIFO, so queueing frames never allocates.
+class FrameQueue final
+{
+public:
+
+	void Reserve(const std::size_t capacity) { m_frames.resize(capacity); }
+
+	std::size_t Size()  const { return m_count; }
+	bool        Empty() const { return m_count == 0; }
+	bool        Full()  const { return m_count == m_frames.size(); }
+
+	void Push(const EncodedFrame& frame)
+	{
+		assert(!Full());
+		m_frames[(m_head + m_count) % m_frames.size()] = frame;
+		++m_count;
+	}
+
+	EncodedFrame Pop()
+	{
+		assert(!Empty());
+		EncodedFrame frame = std::move(m_frames[m_head]);
+		m_head = (m_head + 1) % m_frames.size();
+		--m_count;
+		return frame;
+	}
+
+	void Clear()
+	{
+		while (!Empty())
+		{
+			Pop();
+		}
+	}
+
+private:
+
+	std::vector<EncodedFrame> m_frames;
+	std::size_t m_head  = 0;
+	std::size_t m_count = 0;
+};
+
+} // namespace
+
+// ========================================================
+// FileSink
+// ========================================================
+
+FileSink::FileSink(const char* filename)
+{
+	assert(filename != nullptr);
+
+	HANDLE file = CreateFileA(filename, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		m_file = file;
+	}
+}
+
+FileSink::~FileSink()
+{
+	if (m_file != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(m_file));
+	}
+}
+
+SinkStatus FileSink::Write(const std::uint8_t* data, const std::size_t size)
+{
+	if (m_file == nullptr || !WriteAll(static_cast<HANDLE>(m_file), data, size))
+	{
+		return SinkStatus::Closed;
+	}
+
+	return SinkStatus::Ok;
+}
+
+// ========================================================
+// PipeSink
+// ========================================================
+
+struct PipeSink::Overlapped
+{
+	OVERLAPPED overlapped = {};
+};
+
+PipeSink::PipeSink(const char* name)
+	: m_overlapped{ new Overlapped() }
+{
+	assert(name != nullptr);
+
+	const std::string pipeName = std::string{ "\\\\.\\pipe\\" } + name;
+
+	// Manual reset, as required for overlapped I/O. Connecting never blocks the sink thread,
+	// and a write blocked on a watcher that stopped reading can be cancelled from another thread.
+	HANDLE event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	if (event == nullptr)
+	{
+		return;
+	}
+
+	HANDLE pipe = CreateNamedPipeA(pipeName.c_str(), PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED,
+		PIPE_TYPE_BYTE | PIPE_WAIT, 1, 64 * 1024, 0, 0, nullptr);
+
+	if (pipe == INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(event);
+		return;
+	}
+
+	m_overlapped->overlapped.hEvent = event;
+	m_pipe = pipe;
+}
+
+PipeSink::~PipeSink()
+{
+	if (m_pipe == nullptr)
+	{
+		return;
+	}
+
+	HANDLE pipe = static_cast<HANDLE>(m_pipe);
+
+	// The OVERLAPPED must outlive a pending connect.
+	if (m_connecting)
+	{
+		DWORD unused = 0;
+		CancelIoEx(pipe, &m_overlapped->overlapped);
+		GetOverlappedResult(pipe, &m_overlapped->overlapped, &unused, TRUE);
+	}
+
+	DisconnectNamedPipe(pipe);
+	CloseHandle(pipe);
+	CloseHandle(m_overlapped->overlapped.hEvent);
+}
+
+bool PipeSink::TryConnect()
+{
+	HANDLE pipe = static_cast<HANDLE>(m_pipe);
+	OVERLAPPED& overlapped = m_overlapped->overlapped;
+
+	if (!m_connecting)
+	{
+		// Completing right away means a watcher was already waiting.
+		if (!ConnectNamedPipe(pipe, &overlapped))
+		{
+			switch (GetLastError())
+			{
+			case ERROR_IO_PENDING: // Listening, checked below and on the next polls
+				m_connecting = true;
+				break;
+
+			case ERROR_PIPE_CONNECTED:
+				m_connected = true;
+				return true;
+
+			case ERROR_NO_DATA: // A watcher came and went; recycle the pipe instance
+				DisconnectNamedPipe(pipe);
+				return false;
+
+			default:
+				return false;
+			}
+		}
+		else
+		{
+			m_connected = true;
+			return true;
+		}
+	}
+
+	DWORD unused = 0;
+	if (!GetOverlappedResult(pipe, &overlapped, &unused, FALSE))
+	{
+		if (GetLastError() != ERROR_IO_INCOMPLETE)
+		{
+			// The connect failed; listen again on the next poll.
+			m_connecting = false;
+			DisconnectNamedPipe(pipe);
+		}
+		return false;
+	}
+
+	m_connecting = false;
+	m_connected  = true;
+	return true;
+}
+
+// Writes everything or fails, waiting for each overlapped write to complete.
+bool PipeSink::WriteAllOverlapped(const std::uint8_t* data, std::size_t size)
+{
+	HANDLE pipe = static_cast<HANDLE>(m_pipe);
+	OVERLAPPED& overlapped = m_overlapped->overlapped;
+
+	while (size > 0)
+	{
+		const DWORD chunk = static_cast<DWORD>(size < 0x40000000 ? size : 0x40000000);
+
+		if (!WriteFile(pipe, data, chunk, nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+		{
+			return false;
+		}
+
+		// Cancel() may have run before the write was issued, too early for its CancelIoEx().
+		if (m_cancelled)
+		{
+			CancelIoEx(pipe, &overlapped);
+		}
+
+		DWORD written = 0;
+		if (!GetOverlappedResult(pipe, &overlapped, &written, TRUE) || written == 0)
+		{
+			return false;
+		}
+
+		data += written;
+		size -= written;
+	}
+
+	return true;
+}
+
+SinkStatus PipeSink::Write(const std::uint8_t* data, const std::size_t size)
+{
+	if (m_pipe == nullptr || m_cancelled)
+	{
+		return SinkStatus::Closed;
+	}
+
+	if (!m_connected && !TryConnect())
+	{
+		return SinkStatus::NotReady;
+	}
+
+	if (!WriteAllOverlapped(data, size))
+	{
+		// Watcher went away. Go back to listening for the next one.
+		DisconnectNamedPipe(static_cast<HANDLE>(m_pipe));
+		m_connected = false;
+		return SinkStatus::NotReady;
+	}
+
+	return SinkStatus::Ok;
+}
+
+bool PipeSink::Poll()
+{
+	return m_pipe != nullptr && !m_cancelled && (m_connected || TryConnect());
+}
+
+void PipeSink::Cancel()
+{
+	// Fails a Write() blocked on a watcher that stopped reading. Unlike on a synchronous handle,
+	// this doesn't queue up behind the blocked write.
+	m_cancelled = true;
+
+	if (m_pipe != nullptr)
+	{
+		CancelIoEx(static_cast<HANDLE>(m_pipe), nullptr);
+	}
+}
+
+// ========================================================
+// SinkFanout
+// ========================================================
+
+struct SinkFanout::Slot
+{
+	int id = 0;
+	std::shared_ptr<OutputSink> sink;
+	std::thread thread;
+
+	// Everything below is guarded by mutex.
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	FrameQueue queue;
+	SinkStats stats;
+	bool needsKeyframe = true;
+	bool waitingForSink = false; // Write() returned NotReady. Only changed by the sink thread
+	bool stop = false;
+
+	void DropQueued()
+	{
+		stats.framesDropped += queue.Size();
+		queue.Clear();
+		needsKeyframe = true;
+	}
+
+	// Waits a little, then asks the sink whether it can take frames again. Returns false when the slot is stopping.
+	bool WaitForSink()
+	{
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			if (wakeUp.wait_for(lock, std::chrono::milliseconds(100), [this] { return stop; }))
+			{
+				return false;
+			}
+		}
+
+		const bool ready = sink->Poll();
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (ready)
+		{
+			waitingForSink = false;
+			needsKeyframe  = true;
+		}
+		return !stop;
+	}
+
+	void Run()
+	{
+		for (;;)
+		{
+			if (waitingForSink)
+			{
+				if (!WaitForSink())
+				{
+					return;
+				}
+				continue;
+			}
+
+			EncodedFrame frame;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				wakeUp.wait(lock, [this] { return stop || !queue.Empty(); });
+
+				if (stop)
+				{
+					return;
+				}
+
+				frame = queue.Pop();
+			}
+
+			const SinkStatus status = sink->Write(frame->data(), frame->size());
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			switch (status)
+			{
+			case SinkStatus::Ok:
+				++stats.framesSent;
+				break;
+
+			case SinkStatus::NotReady:
+				// Anything queued is a delta against a frame this sink never got.
+				++stats.framesDropped;
+				DropQueued();
+				waitingForSink = true;
+				break;
+
+			case SinkStatus::Closed:
+				++stats.framesDropped;
+				DropQueued();
+				stats.closed = true;
+				return;
+			}
+		}
+	}
+};
+
+SinkFanout::SinkFanout()
+	: m_nextId{ 1 }
+{ }
+
+SinkFanout::~SinkFanout()
+{
+	while (!m_slots.empty())
+	{
+		RemoveSink(m_slots.back()->id);
+	}
+}
+
+int SinkFanout::AddSink(std::shared_ptr<OutputSink> sink, const int maxQueuedFrames)
+{
+	assert(sink != nullptr);
+	assert(maxQueuedFrames > 0);
+
+	std::unique_ptr<Slot> slot{ new Slot() };
+	slot->id = m_nextId++;
+	slot->queue.Reserve(static_cast<std::size_t>(maxQueuedFrames));
+	slot->sink = std::move(sink);
+
+	Slot* slotPtr = slot.get();
+	slot->thread = std::thread{ [slotPtr] { slotPtr->Run(); } };
+
+	m_slots.push_back(std::move(slot));
+	return m_slots.back()->id;
+}
+
+void SinkFanout::RemoveSink(const int id)
+{
+	for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+	{
+		Slot& slot = **it;
+		if (slot.id != id)
+		{
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ slot.mutex };
+			slot.stop = true;
+		}
+
+		slot.sink->Cancel();
+		slot.wakeUp.notify_one();
+		slot.thread.join();
+
+		m_slots.erase(it);
+		return;
+	}
+}
+
+bool SinkFanout::HasSinks() const
+{
+	return !m_slots.empty();
+}
+
+SinkStats SinkFanout::Stats(const int id) const
+{
+	for (const auto& slot : m_slots)
+	{
+		if (slot->id == id)
+		{
+			std::lock_guard<std::mutex> lock{ slot->mutex };
+			return slot->stats;
+		}
+	}
+
+	return SinkStats{};
+}
+
+bool SinkFanout::HasActiveSinks() const
+{
+	for (const auto& slot : m_slots)
+	{
+		std::lock_guard<std::mutex> lock{ slot->mutex };
+
+		if (!slot->stats.closed && !slot->waitingForSink)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool SinkFanout::NeedsKeyframe() const
+{
+	for (const auto& slot : m_slots)
+	{
+		std::lock_guard<std::mutex> lock{ slot->mutex };
+
+		if (!slot->stats.closed && !slot->waitingForSink && (slot->needsKeyframe || slot->queue.Full()))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void SinkFanout::Broadcast(const EncodedFrame& delta, const EncodedFrame& keyframe)
+{
+	assert(delta != nullptr);
+
+	for (const auto& slot : m_slots)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ slot->mutex };
+
+			if (slot->stats.closed)
+			{
+				continue;
+			}
+
+			// Nobody to send it to, e.g. no watcher connected.
+			if (slot->waitingForSink)
+			{
+				continue;
+			}
+
+			// Lagging too far behind: skip what's pending and resync with a full repaint.
+			if (slot->queue.Full())
+			{
+				slot->DropQueued();
+			}
+
+			if (slot->needsKeyframe)
+			{
+				// The sink may have fallen out of sync after NeedsKeyframe() was checked.
+				// If there's no keyframe this time it'll get one on the next frame.
+				if (keyframe == nullptr)
+				{
+					++slot->stats.framesDropped;
+					continue;
+				}
+
+				slot->queue.Push(keyframe);
+				slot->needsKeyframe = false;
+			}
+			else
+			{
+				slot->queue.Push(delta);
+			}
+		}
+
+		slot->wakeUp.notify_one();
+	}
+}
+
+} // namespace console
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace console
+{
+
+enum class SinkStatus : std::uint8_t
+{
+	Ok,       // All bytes written
+	NotReady, // Nothing written (e.g. no viewer connected). Frames are held back until Poll() succeeds, then resume with a full repaint.
+	Closed,   // The sink failed for good and will receive no more frames
+};
+
+// Destination for the encoded (VT escape sequence) frame stream.
+// Write() is always called from a dedicated thread per sink, so it may block.
+class OutputSink
+{
+public:
+
+	virtual ~OutputSink() = default;
+
+	virtual SinkStatus Write(const std::uint8_t* data, const std::size_t size) = 0;
+
+	// Called from the sink's thread every so often after Write() returned NotReady.
+	// Returns true once frames can be written again. No frames are encoded for the sink meanwhile.
+	virtual bool Poll() { return true; }
+
+	// Called from the presenting thread when the sink is being removed,
+	// to unblock a pending Write() if possible.
+	virtual void Cancel() { }
+};
+
+// Appends the frame stream to a file. 'type'/'cat' it on a VT terminal to replay.
+class FileSink final : public OutputSink
+{
+public:
+
+	explicit FileSink(const char* filename);
+	~FileSink();
+
+	FileSink(const FileSink&) = delete;
+	FileSink& operator=(const FileSink&) = delete;
+
+	bool IsOpen() const { return m_file != nullptr; }
+
+	SinkStatus Write(const std::uint8_t* data, const std::size_t size) override;
+
+private:
+
+	void* m_file = nullptr; // Win32 HANDLE
+};
+
+// Serves the frame stream on a local named pipe (\\.\pipe\<name>), for one watcher at a time.
+// Watchers may connect and disconnect at any time; each new connection starts with a full repaint.
+// The pipe uses overlapped I/O, so that Cancel() can abort a write blocked on a watcher that stopped reading.
+class PipeSink final : public OutputSink
+{
+public:
+
+	explicit PipeSink(const char* name);
+	~PipeSink();
+
+	PipeSink(const PipeSink&) = delete;
+	PipeSink& operator=(const PipeSink&) = delete;
+
+	bool IsOpen() const { return m_pipe != nullptr; }
+
+	SinkStatus Write(const std::uint8_t* data, const std::size_t size) override;
+	bool Poll() override;
+	void Cancel() override;
+
+private:
+
+	bool TryConnect();
+	bool WriteAllOverlapped(const std::uint8_t* data, std::size_t size);
+
+	struct Overlapped; // Win32 OVERLAPPED and its event, shared by the connect and the writes
+
+	void*                       m_pipe       = nullptr; // Win32 HANDLE
+	std::unique_ptr<Overlapped> m_overlapped;
+	bool                        m_connecting = false; // A ConnectNamedPipe() is pending
+	bool                        m_connected  = false;
+	std::atomic<bool>           m_cancelled{ false };
+};
+
+// A frame encoded once and shared, read-only, by every sink.
+using EncodedFrame = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+struct SinkStats
+{
+	std::uint64_t framesSent    = 0;
+	std::uint64_t framesDropped = 0;
+	bool          closed        = false;
+};
+
+// Feeds encoded frames to any number of sinks, each drained by its own thread
+// through a bounded queue. A sink whose queue is full has its pending frames
+// dropped and is resynchronized with a full repaint, so a slow sink never
+// blocks the presenting thread or the other sinks.
+class SinkFanout final
+{
+public:
+
+	SinkFanout();
+	~SinkFanout();
+
+	SinkFanout(const SinkFanout&) = delete;
+	SinkFanout& operator=(const SinkFanout&) = delete;
+
+	// Returns an id to use with RemoveSink()/Stats(). maxQueuedFrames must be at least 1.
+	int  AddSink(std::shared_ptr<OutputSink> sink, const int maxQueuedFrames);
+	void RemoveSink(const int id);
+
+	bool HasSinks() const;
+
+	// True if any sink currently takes frames: not closed, and not waiting for its Poll() to succeed.
+	bool HasActiveSinks() const;
+	SinkStats Stats(const int id) const;
+
+	// True if any sink needs a full repaint instead of the delta.
+	bool NeedsKeyframe() const;
+
+	// Queues the delta frame for every synchronized sink and the keyframe for the others.
+	// keyframe may be null if NeedsKeyframe() returned false.
+	void Broadcast(const EncodedFrame& delta, const EncodedFrame& keyframe);
+
+private:
+
+	struct Slot;
+	std::vector<std::unique_ptr<Slot>> m_slots;
+	int m_nextId;
+};
+
+} // namespace console
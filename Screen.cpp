@@ -1,8 +1,19 @@
 #include "Screen.h"
+#include "FrameLog.h"
+#include "OutputSink.h"
+#include "VtEncoder.h"
+#include "CellBuffer.h"
+#include "Unicode.h"
+#include "Blend.h"
 
 #include <cassert>
-#include <cstdlib>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #define NOUSER   // Suppress DrawTextA|W macro
@@ -28,49 +39,986 @@ const Colour Colour::DarkBlue    = { 0,   0,   128 };
 
 struct Screen::Impl
 {
+	// Set on draw entries written this frame, next to the double-width half flags.
+	static constexpr std::uint16_t EntryDrawn = 0x8000;
+
+	// Depth of cells not drawn this frame, behind every tint layer.
+	static constexpr std::uint16_t UndrawnDepth = 0xFFFF;
+
+	static constexpr int MaxTintLayers = 16;
+
 	struct DrawEntry
 	{
-		std::uint16_t z       = 0xFF;
-		std::uint16_t index   = 0;
-		std::uint16_t attribs = 0;
-		std::uint8_t  ch      = 0;
+		std::uint16_t z     = 0xFF;
+		std::uint16_t ch    = 0; // UTF-16 code unit
+		std::uint16_t flags = 0;
+		std::uint32_t fg    = 0; // Packed RGB, see PackColour()
+		std::uint32_t bg    = 0;
 	};
 
-	bool screenDirty = false;
-	std::vector<DrawEntry> buffer;
+	bool screenDirty = false;
+	std::vector<DrawEntry> buffer;
+
+	// Full RGB colours of the character buffer cells, same layout. Colours are only reduced
+	// to console attributes when the draw buffer is resolved. Tints are never blended in here.
+	struct Surface
+	{
+		std::vector<std::uint32_t> fg;
+		std::vector<std::uint32_t> bg;
+	} surface;
+
+	// Translucent layers, blended by the last resolve of the frame (see Present()).
+	// Kept farthest first, so that nearer layers are composited on top.
+	struct TintLayer
+	{
+		int           left    = 0; // Buffer columns [left, right), rows [top, bottom)
+		int           right   = 0;
+		int           top     = 0;
+		int           bottom  = 0;
+		std::uint16_t z       = UndrawnDepth;
+		std::uint32_t colour  = 0;
+		BlendMode     mode    = BlendMode::Alpha;
+		std::uint8_t  opacity = 0;
+	};
+
+	struct TintLayers
+	{
+		std::array<TintLayer, MaxTintLayers> layers;
+		int count = 0;
+	};
+
+	TintLayers tints;     // Added this frame
+	TintLayers lastTints; // Blended into the console attributes by the last present, restored by the next one
+
+	// Scratch for blending one row, indexed by buffer column: the depth of each cell and
+	// the colours being blended, copied from the surface.
+	struct TintRow
+	{
+		std::vector<std::uint16_t> depth;
+		std::vector<std::uint32_t> fg;
+		std::vector<std::uint32_t> bg;
+
+		void Resize(const int width)
+		{
+			depth.resize(static_cast<std::size_t>(width));
+			fg.resize(static_cast<std::size_t>(width));
+			bg.resize(static_cast<std::size_t>(width));
+		}
+	} tintRow;
+
+	// Rows of the character buffer changed since the last present, [dirtyTop, dirtyBottom).
+	// Only these rows are resolved and written out, so a frame costs what it changed.
+	int dirtyTop    = 0;
+	int dirtyBottom = 0;
+
+	struct ConsoleState
+	{
+		HANDLE                 stdHandle;
+		SMALL_RECT             windowRect;
+		SMALL_RECT             writeArea;
+		COORD                  characterBufferSize;
+		COORD                  characterPosition;
+		CONSOLE_CURSOR_INFO    cursorInfo;
+		std::vector<CHAR_INFO> characterBuffer;
+	} consoleState = {};
+
+	struct RecordingState
+	{
+		FrameWriter                           writer;
+		std::vector<FrameCell>                cells; // Only used once the screen no longer matches the log size
+		std::chrono::steady_clock::time_point startTime;
+	} recording;
+
+	struct SinkState
+	{
+		SinkFanout             fanout;
+		std::vector<FrameCell> previousCells; // Last frame broadcast, for the delta encoding
+
+		std::unique_ptr<VtParallelEncoder> encoder = std::make_unique<VtParallelEncoder>(1);
+		unsigned                           encodeThreads = 1; // As requested, 0 = one per core
+
+		// Encoded frame buffers are recycled once no sink references them anymore.
+		// The pool is sized for the worst case (every sink queue full, plus the frame being
+		// written by each sink, plus this frame's delta and keyframe) and each buffer is
+		// reserved for the largest possible frame, so encoding never allocates.
+		std::vector<std::shared_ptr<std::vector<std::uint8_t>>> bufferPool;
+		std::size_t buffersNeeded = 2;
+
+		void ReserveBuffers(const int width, const int height)
+		{
+			// Per cell worst case: CUP + SGR + 3 bytes of UTF-8. Plus clear screen/scroll sequences.
+			const std::size_t bytes = (static_cast<std::size_t>(width) * height * 24) + 256;
+
+			while (bufferPool.size() < buffersNeeded)
+			{
+				bufferPool.push_back(std::make_shared<std::vector<std::uint8_t>>());
+			}
+
+			for (const auto& pooled : bufferPool)
+			{
+				pooled->reserve(bytes);
+			}
+		}
+
+		std::shared_ptr<std::vector<std::uint8_t>> AcquireBuffer()
+		{
+			for (const auto& pooled : bufferPool)
+			{
+				if (pooled.use_count() == 1)
+				{
+					// Pairs with the release in the sink thread dropping its last reference.
+					std::atomic_thread_fence(std::memory_order_acquire);
+					pooled->clear();
+					return pooled;
+				}
+			}
+
+			bufferPool.push_back(std::make_shared<std::vector<std::uint8_t>>());
+			return bufferPool.back();
+		}
+	} sinks;
+
+	// Presented frame in FrameCell form, shared by the recorder and the sinks.
+	std::vector<FrameCell> frameCells;
+
+	// Full-width scrolls done since the last present, replayed on the sinks' terminals.
+	std::vector<VtScroll> pendingScrolls;
+
+	// Polls the console window size in the background. There's no SIGWINCH equivalent for a
+	// console app that doesn't read input events itself, and we don't want to steal std::cin input.
+	struct ResizeWatcher
+	{
+		std::thread                thread;
+		std::mutex                 mutex;
+		std::condition_variable    wakeUp;
+		bool                       stop = false;
+		std::atomic<std::uint32_t> windowSize{ 0 }; // (width << 16) | height
+		std::uint32_t              appliedSize = 0; // Last windowSize acted upon, presenting thread only
+		bool                       follow      = false; // Presenting thread only
+		COORD                      maximumSize = {};
+	} resizeWatcher;
+
+	Impl() = default;
+	Impl(const Impl&) = delete;
+	Impl& operator=(const Impl&) = delete;
+
+	~Impl()
+	{
+		if (resizeWatcher.thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock{ resizeWatcher.mutex };
+				resizeWatcher.stop = true;
+			}
+			resizeWatcher.wakeUp.notify_one();
+			resizeWatcher.thread.join();
+		}
+	}
+
+	void MarkRowsDirty(const int top, const int bottom)
+	{
+		if (dirtyTop >= dirtyBottom)
+		{
+			dirtyTop    = top;
+			dirtyBottom = bottom;
+		}
+		else
+		{
+			dirtyTop    = std::min(dirtyTop, top);
+			dirtyBottom = std::max(dirtyBottom, bottom);
+		}
+	}
+
+	void MarkAllRowsDirty()
+	{
+		dirtyTop    = 0;
+		dirtyBottom = consoleState.characterBufferSize.Y;
+	}
+
+	static std::uint32_t PackSize(const int width, const int height)
+	{
+		return (static_cast<std::uint32_t>(width) << 16) | static_cast<std::uint32_t>(height & 0xFFFF);
+	}
+
+	void StartResizeWatcher()
+	{
+		resizeWatcher.appliedSize = PackSize(consoleState.characterBufferSize.X, consoleState.characterBufferSize.Y);
+		resizeWatcher.windowSize  = resizeWatcher.appliedSize;
+		resizeWatcher.thread = std::thread{ [this] { WatchWindowSize(); } };
+	}
+
+	void WatchWindowSize()
+	{
+		std::unique_lock<std::mutex> lock{ resizeWatcher.mutex };
+
+		while (!resizeWatcher.stop)
+		{
+			CONSOLE_SCREEN_BUFFER_INFO info = {};
+			if (GetConsoleScreenBufferInfo(consoleState.stdHandle, &info))
+			{
+				const int w = std::min(info.srWindow.Right  - info.srWindow.Left + 1, static_cast<int>(resizeWatcher.maximumSize.X));
+				const int h = std::min(info.srWindow.Bottom - info.srWindow.Top  + 1, static_cast<int>(resizeWatcher.maximumSize.Y));
+
+				if (w > 0 && h > 0)
+				{
+					resizeWatcher.windowSize = PackSize(w, h);
+				}
+			}
+
+			resizeWatcher.wakeUp.wait_for(lock, std::chrono::milliseconds(100));
+		}
+	}
+
+	// Copies the overlapping part of a row-major cell buffer into a buffer of a different size.
+	template<typename Cell>
+	static void CopyCells(const Cell* src, const int srcW, const int srcH, Cell* dst, const int dstW, const int dstH)
+	{
+		const int copyW = std::min(srcW, dstW);
+		const int copyH = std::min(srcH, dstH);
+
+		for (int y = 0; y < copyH; ++y)
+		{
+			std::copy(src + (y * srcW), src + (y * srcW) + copyW, dst + (y * dstW));
+		}
+	}
+
+	template<typename Cell>
+	static void ResizeCells(std::vector<Cell>& cells, const int oldW, const int oldH, const int newW, const int newH, const Cell& fill)
+	{
+		std::vector<Cell> resized(static_cast<std::size_t>(newW * newH), fill);
+		CopyCells(cells.data(), oldW, oldH, resized.data(), newW, newH);
+		cells.swap(resized);
+	}
+
+	// Sets the console buffer and window to newSize. The buffer can't be smaller than the window,
+	// so the window is first shrunk to the area both sizes share, then the buffer is resized and
+	// the window grown to fill it. On failure the console is put back to oldSize.
+	bool SetConsoleSize(const COORD oldSize, const COORD newSize)
+	{
+		const HANDLE handle = consoleState.stdHandle;
+
+		const SMALL_RECT oldWindow    = { 0, 0, static_cast<SHORT>(oldSize.X - 1), static_cast<SHORT>(oldSize.Y - 1) };
+		const SMALL_RECT newWindow    = { 0, 0, static_cast<SHORT>(newSize.X - 1), static_cast<SHORT>(newSize.Y - 1) };
+		const SMALL_RECT sharedWindow = { 0, 0, std::min(oldWindow.Right, newWindow.Right), std::min(oldWindow.Bottom, newWindow.Bottom) };
+
+		if (!SetConsoleWindowInfo(handle, TRUE, &sharedWindow))
+		{
+			return false;
+		}
+
+		if (!SetConsoleScreenBufferSize(handle, newSize))
+		{
+			SetConsoleWindowInfo(handle, TRUE, &oldWindow);
+			return false;
+		}
+
+		if (!SetConsoleWindowInfo(handle, TRUE, &newWindow))
+		{
+			SetConsoleScreenBufferSize(handle, oldSize);
+			SetConsoleWindowInfo(handle, TRUE, &oldWindow);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Returns true if the size changed. If the console refuses the new size, nothing changes.
+	bool Resize(const int width, const int height)
+	{
+		const int oldW = consoleState.characterBufferSize.X;
+		const int oldH = consoleState.characterBufferSize.Y;
+
+		if (width == oldW && height == oldH)
+		{
+			return false;
+		}
+
+		const auto w = static_cast<short>(width);
+		const auto h = static_cast<short>(height);
+
+		// May fail transiently while the user is still dragging the window.
+		if (!SetConsoleSize(consoleState.characterBufferSize, COORD{ w, h }))
+		{
+			return false;
+		}
+
+		// Pending draws use indices of the old layout, so bake them into the character buffer first.
+		// Pending tints are clipped to the new size when blended.
+		RestoreTintedCells();
+		ResolveDrawBuffer(false);
+		ResizeCells(consoleState.characterBuffer, oldW, oldH, width, height, CHAR_INFO{});
+		ResizeCells(surface.fg, oldW, oldH, width, height, std::uint32_t{ 0 });
+		ResizeCells(surface.bg, oldW, oldH, width, height, std::uint32_t{ 0 });
+		buffer.assign(static_cast<std::size_t>(width * height), DrawEntry{});
+		tintRow.Resize(width);
+
+		consoleState.windowRect          = { 0, 0, static_cast<short>(w - 1), static_cast<short>(h - 1) };
+		consoleState.writeArea           = consoleState.windowRect;
+		consoleState.characterBufferSize = { w, h };
+
+		SetConsoleCursorInfo(consoleState.stdHandle, &consoleState.cursorInfo);
+
+		// Mirrored outputs keep what they already show; only the newly exposed area is unknown and gets repainted.
+		if (!sinks.previousCells.empty())
+		{
+			FrameCell unknown;
+			unknown.ch      = 0xFFFF;
+			unknown.attribs = 0xFFFF;
+			ResizeCells(sinks.previousCells, oldW, oldH, width, height, unknown);
+		}
+
+		if (sinks.fanout.HasSinks())
+		{
+			sinks.ReserveBuffers(width, height);
+		}
+
+		pendingScrolls.clear();
+		MarkAllRowsDirty();
+		screenDirty = true;
+		return true;
+	}
+
+	bool ApplyPendingResize()
+	{
+		// Only follow the window when it actually changed, so an explicit Screen::Resize() sticks.
+		const std::uint32_t size = resizeWatcher.windowSize;
+		if (!resizeWatcher.follow || size == resizeWatcher.appliedSize)
+		{
+			return false;
+		}
+
+		const int width  = static_cast<int>(size >> 16);
+		const int height = static_cast<int>(size & 0xFFFF);
+
+		// A size the console refused is tried again on the next present.
+		const bool resized = Resize(width, height);
+		if (resized || (width == consoleState.characterBufferSize.X && height == consoleState.characterBufferSize.Y))
+		{
+			resizeWatcher.appliedSize = size;
+		}
+
+		return resized;
+	}
+
+	// Copy drawn entries to the console buffer and the surface and clear each entry. Nothing is
+	// drawn outside the dirty rows. Colours are reduced to console attributes here.
+	// The tint layers of the frame are only blended by its last resolve (blendTints), so that they
+	// also cover what a Scroll() moved in. They are then kept in lastTints, for the next present to undo.
+	void ResolveDrawBuffer(const bool blendTints)
+	{
+		const int bufferW = consoleState.characterBufferSize.X;
+		const TintLayer* const tintsBegin = tints.layers.data();
+		const TintLayer* const tintsEnd   = tintsBegin + tints.count;
+
+		for (int y = dirtyTop; y < dirtyBottom; ++y)
+		{
+			const std::size_t rowStart = static_cast<std::size_t>(y) * bufferW;
+			DrawEntry* row = buffer.data() + rowStart;
+
+			const bool tinted = blendTints && std::any_of(tintsBegin, tintsEnd,
+				[y](const TintLayer& tint) { return y >= tint.top && y < tint.bottom; });
+
+			if (tinted)
+			{
+				// Cells not drawn this frame (or only before a Scroll()) are behind every layer.
+				for (int x = 0; x < bufferW; ++x)
+				{
+					tintRow.depth[x] = ((row[x].flags & EntryDrawn) != 0) ? row[x].z : UndrawnDepth;
+				}
+			}
+
+			// Entries not drawn this frame are still cleared from the last one.
+			for (int x = 0; x < bufferW; ++x)
+			{
+				DrawEntry& entry = row[x];
+				if ((entry.flags & EntryDrawn) != 0)
+				{
+					CHAR_INFO& charInfo = consoleState.characterBuffer[rowStart + x];
+					charInfo.Char.UnicodeChar = static_cast<WCHAR>(entry.ch);
+					charInfo.Attributes = static_cast<WORD>((entry.flags & ~EntryDrawn) | QuantizeColours(entry.fg, entry.bg));
+
+					surface.fg[rowStart + x] = entry.fg;
+					surface.bg[rowStart + x] = entry.bg;
+
+					entry = {};
+				}
+			}
+
+			if (tinted)
+			{
+				BlendTints(y);
+			}
+		}
+
+		if (blendTints)
+		{
+			lastTints   = tints;
+			tints.count = 0;
+		}
+	}
+
+	// Blends the layers covering row y over a copy of its surface colours, and reduces the
+	// result to console attributes. tintRow.depth already holds the depth of each cell.
+	void BlendTints(const int y)
+	{
+		const int bufferW = consoleState.characterBufferSize.X;
+		const std::size_t rowStart = static_cast<std::size_t>(y) * bufferW;
+
+		int left  = bufferW;
+		int right = 0;
+
+		for (int i = 0; i < tints.count; ++i)
+		{
+			const TintLayer& tint = tints.layers[i];
+			if (y >= tint.top && y < tint.bottom)
+			{
+				left  = std::min(left, tint.left);
+				right = std::max(right, std::min(tint.right, bufferW));
+			}
+		}
+
+		if (left >= right)
+		{
+			return;
+		}
+
+		const std::uint32_t* const fg = surface.fg.data() + rowStart;
+		const std::uint32_t* const bg = surface.bg.data() + rowStart;
+		std::copy(fg + left, fg + right, tintRow.fg.data() + left);
+		std::copy(bg + left, bg + right, tintRow.bg.data() + left);
+
+		for (int i = 0; i < tints.count; ++i)
+		{
+			const TintLayer& tint = tints.layers[i];
+			const int count = std::min(tint.right, bufferW) - tint.left;
+
+			if (y < tint.top || y >= tint.bottom || count <= 0)
+			{
+				continue;
+			}
+
+			BlendRow(tintRow.fg.data() + tint.left, tintRow.depth.data() + tint.left, count, tint.z, tint.colour, tint.mode, tint.opacity);
+			BlendRow(tintRow.bg.data() + tint.left, tintRow.depth.data() + tint.left, count, tint.z, tint.colour, tint.mode, tint.opacity);
+		}
+
+		CHAR_INFO* const row = consoleState.characterBuffer.data() + rowStart;
+		for (int x = left; x < right; ++x)
+		{
+			row[x].Attributes = static_cast<WORD>((row[x].Attributes & ~CellColourMask) | QuantizeColours(tintRow.fg[x], tintRow.bg[x]));
+		}
+	}
+
+	// Layers only last for the frame they were added in: reduces the untinted surface colours of
+	// the cells blended by the last present back to console attributes.
+	void RestoreTintedCells()
+	{
+		const int bufferW = consoleState.characterBufferSize.X;
+		const int bufferH = consoleState.characterBufferSize.Y;
+
+		for (int i = 0; i < lastTints.count; ++i)
+		{
+			const TintLayer& tint = lastTints.layers[i];
+			const int right  = std::min(tint.right,  bufferW);
+			const int bottom = std::min(tint.bottom, bufferH);
+
+			if (tint.left >= right || tint.top >= bottom)
+			{
+				continue;
+			}
+
+			for (int y = tint.top; y < bottom; ++y)
+			{
+				const std::size_t rowStart = static_cast<std::size_t>(y) * bufferW;
+				CHAR_INFO* const row = consoleState.characterBuffer.data() + rowStart;
+
+				for (int x = tint.left; x < right; ++x)
+				{
+					row[x].Attributes = static_cast<WORD>((row[x].Attributes & ~CellColourMask) | QuantizeColours(surface.fg[rowStart + x], surface.bg[rowStart + x]));
+				}
+			}
+
+			MarkRowsDirty(tint.top, bottom);
+		}
+
+		lastTints.count = 0;
+	}
+
+	void WriteToConsole()
+	{
+		if (dirtyTop < dirtyBottom)
+		{
+			// The rest of the console already shows the retained character buffer.
+			SMALL_RECT writeArea = consoleState.writeArea;
+			writeArea.Top    = static_cast<SHORT>(dirtyTop);
+			writeArea.Bottom = static_cast<SHORT>(dirtyBottom - 1);
+
+			COORD position = consoleState.characterPosition;
+			position.Y = static_cast<SHORT>(dirtyTop);
+
+			const BOOL result = WriteConsoleOutputW(consoleState.stdHandle,
+				consoleState.characterBuffer.data(),
+				consoleState.characterBufferSize,
+				position,
+				&writeArea);
+			assert(result == TRUE);
+		}
+
+		if (recording.writer.IsOpen() || sinks.fanout.HasSinks())
+		{
+			UpdateFrameCells();
+
+			if (recording.writer.IsOpen())
+			{
+				RecordFrame();
+			}
+
+			if (sinks.fanout.HasSinks())
+			{
+				BroadcastFrame();
+			}
+		}
+		else
+		{
+			// Not kept up to date, so the next UpdateFrameCells() has to copy everything.
+			frameCells.clear();
+		}
+
+		pendingScrolls.clear();
+		dirtyTop    = 0;
+		dirtyBottom = 0;
+	}
+
+	void UpdateFrameCells()
+	{
+		const std::size_t count = consoleState.characterBuffer.size();
+		const std::size_t bufferW = static_cast<std::size_t>(consoleState.characterBufferSize.X);
+
+		std::size_t first = dirtyTop * bufferW;
+		std::size_t last  = dirtyBottom * bufferW;
+
+		if (frameCells.size() != count)
+		{
+			frameCells.resize(count);
+			first = 0;
+			last  = count;
+		}
+
+		for (std::size_t i = first; i < last; ++i)
+		{
+			const CHAR_INFO& charInfo = consoleState.characterBuffer[i];
+			frameCells[i].ch      = static_cast<std::uint16_t>(charInfo.Char.UnicodeChar);
+			frameCells[i].attribs = charInfo.Attributes;
+		}
+	}
+
+	void RecordFrame()
+	{
+		const auto elapsed = std::chrono::steady_clock::now() - recording.startTime;
+		const auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+
+		const int w = consoleState.characterBufferSize.X;
+		const int h = consoleState.characterBufferSize.Y;
+
+		// The log keeps the size it was started with. After a resize, frames are cropped/padded to it.
+		if (recording.writer.Width() == w && recording.writer.Height() == h)
+		{
+			recording.writer.WriteFrame(frameCells.data(), static_cast<std::uint64_t>(timestamp));
+			return;
+		}
+
+		recording.cells.assign(static_cast<std::size_t>(recording.writer.Width() * recording.writer.Height()), FrameCell{});
+		CopyCells(frameCells.data(), w, h, recording.cells.data(), recording.writer.Width(), recording.writer.Height());
+		recording.writer.WriteFrame(recording.cells.data(), static_cast<std::uint64_t>(timestamp));
+	}
+
+	void BroadcastFrame()
+	{
+		const int w = consoleState.characterBufferSize.X;
+		const int h = consoleState.characterBufferSize.Y;
+
+		// Nobody is reading (e.g. no watcher connected): don't encode anything. Sinks
+		// that come back start with a keyframe, so only the reference frame is kept.
+		if (!sinks.fanout.HasActiveSinks())
+		{
+			sinks.previousCells = frameCells;
+			return;
+		}
+
+		// Encode once, share the same bytes with every sink.
+		const bool hasPrevious = (sinks.previousCells.size() == frameCells.size());
+
+		auto delta = sinks.AcquireBuffer();
+		if (hasPrevious)
+		{
+			// Let the terminals move scrolled lines themselves; the diff then only sees the new lines.
+			for (const VtScroll& scroll : pendingScrolls)
+			{
+				EncodeVtScroll(scroll, sinks.previousCells.data(), w, h, *delta);
+			}
+		}
+		sinks.encoder->Encode(frameCells.data(), hasPrevious ? sinks.previousCells.data() : nullptr, w, h, *delta);
+
+		EncodedFrame keyframe;
+		if (!hasPrevious)
+		{
+			keyframe = delta;
+		}
+		else if (sinks.fanout.NeedsKeyframe())
+		{
+			auto full = sinks.AcquireBuffer();
+			sinks.encoder->Encode(frameCells.data(), nullptr, w, h, *full);
+			keyframe = std::move(full);
+		}
+
+		sinks.fanout.Broadcast(delta, keyframe);
+		sinks.previousCells = frameCells;
+	}
+
+	// Foreground and background of a draw call, packed once per call.
+	struct CellColours
+	{
+		std::uint32_t fg = 0;
+		std::uint32_t bg = 0;
+	};
+
+	void AddCharToBuffer(const std::uint16_t ch, std::uint16_t x, const std::uint16_t y, const std::uint16_t z, const CellColours& colours)
+	{
+		// Hack: For some reason drawing at 0,0 doesn't seem to work, so I'm scrolling the characterPosition to start at 1 (see below)
+		// so we need to compensate here and add one to the x coordinate since x now starts at 1, not zero.
+		++x;
+
+		const std::size_t index = x + (static_cast<std::size_t>(y) * consoleState.characterBufferSize.X);
+
+		// Simple "depth test" and off-screen clipping
+		if (index < buffer.size() && z <= buffer[index].z)
+		{
+			DrawEntry& entry = buffer[index];
+			entry.z     = z;
+			entry.ch    = ch;
+			entry.flags = EntryDrawn;
+			entry.fg    = colours.fg;
+			entry.bg    = colours.bg;
+
+			const int row = static_cast<int>(index / consoleState.characterBufferSize.X);
+			MarkRowsDirty(row, row + 1);
+		}
+	}
+
+	// One cell of a text run: a UTF-16 code unit plus the double-width half flags.
+	struct RunCell
+	{
+		std::uint16_t ch    = 0;
+		std::uint16_t flags = 0;
+	};
+
+	// Same as AddCharToBuffer for consecutive cells of one row, but the bounds check and
+	// index math are done once per run instead of once per character. Runs are clipped to the row.
+	// The two halves of a double-width character are drawn together or not at all.
+	void AddRunToBuffer(const RunCell* run, const int count, int x, const int y, const std::uint16_t z, const CellColours& colours)
+	{
+		const int bufferW = consoleState.characterBufferSize.X;
+		const int bufferH = consoleState.characterBufferSize.Y;
+
+		// Same +1 column shift as AddCharToBuffer.
+		++x;
+
+		if (y < 0 || y >= bufferH || x >= bufferW)
+		{
+			return;
+		}
+
+		int visible = std::min(count, bufferW - x);
+		if (visible > 0 && (run[visible - 1].flags & CellLeadingHalf) != 0)
+		{
+			--visible; // Its trailing half is clipped
+		}
+
+		if (visible <= 0)
+		{
+			return;
+		}
+
+		MarkRowsDirty(y, y + 1);
+
+		DrawEntry* row = buffer.data() + (y * bufferW) + x;
+
+		for (int i = 0; i < visible; ++i)
+		{
+			const int cells = ((run[i].flags & CellLeadingHalf) != 0) ? 2 : 1;
+
+			if (z <= row[i].z && z <= row[i + cells - 1].z)
+			{
+				for (int c = i; c < i + cells; ++c)
+				{
+					DrawEntry& entry = row[c];
+					entry.z     = z;
+					entry.ch    = run[c].ch;
+					entry.flags = static_cast<std::uint16_t>(EntryDrawn | run[c].flags);
+					entry.fg    = colours.fg;
+					entry.bg    = colours.bg;
+				}
+			}
+
+			i += cells - 1;
+		}
+	}
 
-	struct ConsoleState
+	// Lays out UTF-8 text inside a TextBox and writes it to the draw buffer in runs.
+	class TextWriter final
 	{
-		HANDLE                 stdHandle;
-		SMALL_RECT             windowRect;
-		SMALL_RECT             writeArea;
-		COORD                  characterBufferSize;
-		COORD                  characterPosition;
-		CONSOLE_CURSOR_INFO    cursorInfo;
-		std::vector<CHAR_INFO> characterBuffer;
-	} consoleState = {};
+	public:
 
-	Impl() = default;
-	Impl(const Impl&) = delete;
-	Impl& operator=(const Impl&) = delete;
+		TextWriter(Impl& impl, const TextBox& box, const CellColours& colours)
+			: m_impl{ impl }
+			, m_box{ box }
+			, m_colours{ colours }
+		{ }
 
-	void AddCharToBuffer(const std::uint8_t ch, std::uint16_t x, const std::uint16_t y, const std::uint16_t z, const std::uint16_t attribs)
-	{
-		// Hack: For some reason drawing at 0,0 doesn't seem to work, so I'm scrolling the characterPosition to start at 1 (see below)
-		// so we need to compensate here and add one to the x coordinate since x now starts at 1, not zero.
-		++x;
+		void Write(const std::string_view text)
+		{
+			std::size_t i = 0;
 
-		Impl::DrawEntry entry;
-		entry.z       = z;
-		entry.index   = static_cast<std::uint16_t>(x + (y * consoleState.characterBufferSize.X));
-		entry.attribs = attribs;
-		entry.ch      = ch;
+			while (i < text.size() && m_row < m_box.height)
+			{
+				const char c = text[i];
+
+				if (c == '\n')
+				{
+					++i;
+					NewLine();
+				}
+				else if (m_clipped)
+				{
+					// Rest of the line is past the right edge.
+					i = text.find('\n', i);
+				}
+				else if (c == ' ' || c == '\t')
+				{
+					++i;
+
+					// Spaces where a line was wrapped are dropped.
+					if (m_wrapped && Column() == 0)
+					{
+						continue;
+					}
+
+					const int spaces = (c == '\t') ? TabWidth : 1;
+					for (int s = 0; s < spaces; ++s)
+					{
+						Put(Glyph::Narrow(' '));
+					}
+				}
+				else if (m_box.overflow == TextOverflow::WordWrap)
+				{
+					i = WriteWord(text, i);
+				}
+				else
+				{
+					Glyph glyph;
+					if (DecodeGlyph(text, i, glyph))
+					{
+						Put(glyph);
+					}
+				}
+			}
 
-		// Simple "depth test" and off-screen clipping
-		if (entry.index < buffer.size() && entry.z <= buffer[entry.index].z)
+			Flush();
+		}
+
+	private:
+
+		static constexpr int TabWidth = 4;
+		static constexpr int MaxRun   = 128;
+
+		// Built through Narrow() and Wide(), so that the fields can't be mixed up.
+		struct Glyph
+		{
+			static Glyph Narrow(const std::uint16_t ch) { return Glyph{ ch, ch, 1 }; }
+			static Glyph Wide(const std::uint16_t lead, const std::uint16_t trail) { return Glyph{ lead, trail, 2 }; }
+
+			Glyph() = default;
+
+			std::uint16_t ch    = 0;
+			std::uint16_t trail = 0; // Trailing half of a wide glyph: ch, or the low surrogate
+			int           width = 0;
+
+		private:
+
+			Glyph(const std::uint16_t lead, const std::uint16_t trailHalf, const int cells)
+				: ch{ lead }
+				, trail{ trailHalf }
+				, width{ cells }
+			{ }
+		};
+
+		// Decodes the next character. Returns false if it takes no cells (control and zero-width characters).
+		static bool DecodeGlyph(const std::string_view text, std::size_t& i, Glyph& glyph)
+		{
+			char32_t codePoint = DecodeUtf8(text, i);
+
+			if (codePoint < 0x20 || (codePoint >= 0x7F && codePoint < 0xA0))
+			{
+				return false;
+			}
+
+			const int width = CharWidth(codePoint);
+			if (width == 0)
+			{
+				return false;
+			}
+
+			if (codePoint > 0xFFFF)
+			{
+				// A wide character's surrogate pair is split across its two cells. A narrow one
+				// has a single cell, which only holds one UTF-16 code unit.
+				if (width == 2)
+				{
+					glyph = Glyph::Wide(static_cast<std::uint16_t>(0xD800 + ((codePoint - 0x10000) >> 10)),
+					                    static_cast<std::uint16_t>(0xDC00 + (codePoint & 0x3FF)));
+					return true;
+				}
+
+				codePoint = ReplacementCharacter;
+			}
+
+			const auto ch = static_cast<std::uint16_t>(codePoint);
+			glyph = (width == 2) ? Glyph::Wide(ch, ch) : Glyph::Narrow(ch);
+			return true;
+		}
+
+		// Measures the word first so that it moves to the next line as a whole.
+		// Words wider than the box (or longer than MaxRun characters) are split.
+		std::size_t WriteWord(const std::string_view text, std::size_t i)
+		{
+			Glyph word[MaxRun];
+			int count = 0;
+			int width = 0;
+
+			while (i < text.size() && count < MaxRun)
+			{
+				const char c = text[i];
+				if (c == ' ' || c == '\t' || c == '\n')
+				{
+					break;
+				}
+
+				if (DecodeGlyph(text, i, word[count]))
+				{
+					width += word[count++].width;
+				}
+			}
+
+			if (Column() > 0 && Column() + width > m_box.width)
+			{
+				Wrap();
+			}
+
+			for (int w = 0; w < count && m_row < m_box.height; ++w)
+			{
+				Put(word[w]);
+			}
+
+			return i;
+		}
+
+		void Put(const Glyph& glyph)
+		{
+			if (Column() + glyph.width > m_box.width)
+			{
+				if (m_box.overflow == TextOverflow::Clip)
+				{
+					m_clipped = true;
+					return;
+				}
+
+				// Word wrap: trailing spaces are dropped, words continue on the next line.
+				if (glyph.ch == ' ')
+				{
+					return;
+				}
+
+				Wrap();
+				if (m_row >= m_box.height || glyph.width > m_box.width)
+				{
+					return;
+				}
+			}
+
+			if (m_count + glyph.width > MaxRun)
+			{
+				Flush();
+			}
+
+			if (glyph.width == 2)
+			{
+				m_run[m_count++] = RunCell{ glyph.ch, CellLeadingHalf  };
+				m_run[m_count++] = RunCell{ glyph.trail, CellTrailingHalf };
+			}
+			else
+			{
+				m_run[m_count++] = RunCell{ glyph.ch, 0 };
+			}
+		}
+
+		void Flush()
+		{
+			if (m_count == 0)
+			{
+				return;
+			}
+
+			m_impl.AddRunToBuffer(m_run, m_count, m_box.origin.x + m_runStart, m_box.origin.y + m_row,
+				static_cast<std::uint16_t>(m_box.origin.z), m_colours);
+
+			m_runStart += m_count;
+			m_count = 0;
+		}
+
+		void NewLine()
+		{
+			Flush();
+			++m_row;
+			m_runStart = 0;
+			m_wrapped  = false;
+			m_clipped  = false;
+		}
+
+		void Wrap()
 		{
-			buffer[entry.index] = entry;
+			NewLine();
+			m_wrapped = true;
 		}
+
+		int Column() const { return m_runStart + m_count; }
+
+		Impl&             m_impl;
+		const TextBox&    m_box;
+		const CellColours m_colours;
+
+		RunCell m_run[MaxRun];
+		int     m_count    = 0; // Cells in m_run
+		int     m_runStart = 0; // Column of m_run[0], relative to the box
+		int     m_row      = 0;
+		bool    m_wrapped  = false;
+		bool    m_clipped  = false;
+	};
+
+	// Same mapping as ColourToConsoleAttributes(), for packed colours and without branches, as it runs per cell.
+	static std::uint16_t QuantizeColour(const std::uint32_t packed)
+	{
+		const std::uint32_t r = packed & 0xFF;
+		const std::uint32_t g = (packed >> 8) & 0xFF;
+		const std::uint32_t b = (packed >> 16) & 0xFF;
+
+		return static_cast<std::uint16_t>(((r != 0) ? FOREGROUND_RED   : 0)
+			| ((g != 0) ? FOREGROUND_GREEN : 0)
+			| ((b != 0) ? FOREGROUND_BLUE  : 0)
+			| ((r > 128 || g > 128 || b > 128) ? FOREGROUND_INTENSITY : 0));
+	}
+
+	static std::uint16_t QuantizeColours(const std::uint32_t fg, const std::uint32_t bg)
+	{
+		return static_cast<std::uint16_t>(QuantizeColour(fg) | (QuantizeColour(bg) << 4));
 	}
 
 	static std::uint16_t ColourToConsoleAttributes(const Colour colour, const int layer)
@@ -118,7 +1066,7 @@ struct Screen::Impl
 };
 
 Screen::Screen(const char* title, const int width, const int height)
-	: m_pImpl{ new Impl() }
+	: m_pImpl{ std::make_unique<Impl>() }
 {
 	assert(title != nullptr);
 	assert(width > 0 && height > 0);
@@ -147,48 +1095,181 @@ Screen::Screen(const char* title, const int width, const int height)
 
 	impl.buffer.resize(consoleSize, Impl::DrawEntry{});
 	consoleState.characterBuffer.resize(consoleSize, CHAR_INFO{});
+	impl.surface.fg.resize(consoleSize, 0);
+	impl.surface.bg.resize(consoleSize, 0);
+	impl.tintRow.Resize(consoleW);
 
 	result = SetConsoleTitleA(title);
 	assert(result == TRUE);
 
-	result = SetConsoleWindowInfo(consoleState.stdHandle, TRUE, &consoleState.windowRect);
-	assert(result == TRUE);
-
-	result = SetConsoleScreenBufferSize(consoleState.stdHandle, consoleState.characterBufferSize);
+	result = impl.SetConsoleSize(consoleInfo.dwSize, consoleState.characterBufferSize) ? TRUE : FALSE;
 	assert(result == TRUE);
 
 	result = SetConsoleCursorInfo(consoleState.stdHandle, &consoleState.cursorInfo);
 	assert(result == TRUE);
+
+	impl.MarkAllRowsDirty();
+
+	impl.resizeWatcher.maximumSize = consoleInfo.dwMaximumWindowSize;
 }
 
+Screen::~Screen() = default;
+Screen::Screen(Screen&&) noexcept = default;
+Screen& Screen::operator=(Screen&&) noexcept = default;
+
 void Screen::Present()
 {
 	auto& impl = *m_pImpl;
-	auto& consoleState = impl.consoleState;
 
-	if (!impl.screenDirty)
+	impl.ApplyPendingResize();
+
+	// Cells tinted by the last present are restored even if nothing else was drawn.
+	if (!impl.screenDirty && impl.lastTints.count == 0)
 	{
 		return;
 	}
 
-	// Copy to console buffer and clear each entry
-	for (Impl::DrawEntry& entry : impl.buffer)
+	impl.RestoreTintedCells();
+	impl.ResolveDrawBuffer(true);
+	impl.WriteToConsole();
+	impl.screenDirty = false;
+}
+
+void Screen::PresentCells(const FrameCell* cells, const int width, const int height)
+{
+	assert(cells != nullptr);
+	assert(width > 0 && height > 0);
+
+	auto& impl = *m_pImpl;
+	auto& consoleState = impl.consoleState;
+
+	const int copyW = std::min(width,  Width());
+	const int copyH = std::min(height, Height());
+
+	// Attributes are written as-is. The surface gets matching colours, for cells that are blended later.
+	const auto expand = [](const std::uint16_t attribs, const int shift)
+	{
+		const std::uint32_t level = (attribs & (FOREGROUND_INTENSITY << shift)) ? 255 : 128;
+		return ((attribs & (FOREGROUND_RED   << shift)) ? level         : 0)
+			 | ((attribs & (FOREGROUND_GREEN << shift)) ? (level << 8)  : 0)
+			 | ((attribs & (FOREGROUND_BLUE  << shift)) ? (level << 16) : 0);
+	};
+
+	// A smaller frame only covers part of the screen, the rest is blanked as by Clear().
+	if (copyW < Width() || copyH < Height())
 	{
-		CHAR_INFO& charInfo = consoleState.characterBuffer[entry.index];
-		charInfo.Char.AsciiChar = static_cast<CHAR>(entry.ch);
-		charInfo.Attributes = entry.attribs;
+		std::fill(consoleState.characterBuffer.begin(), consoleState.characterBuffer.end(), CHAR_INFO{});
+		std::fill(impl.surface.fg.begin(), impl.surface.fg.end(), 0);
+		std::fill(impl.surface.bg.begin(), impl.surface.bg.end(), 0);
+	}
 
-		entry = {};
+	for (int y = 0; y < copyH; ++y)
+	{
+		const FrameCell* srcRow = cells + (y * width);
+		const std::size_t rowStart = static_cast<std::size_t>(y) * Width();
+		CHAR_INFO* dstRow = consoleState.characterBuffer.data() + rowStart;
+
+		for (int x = 0; x < copyW; ++x)
+		{
+			dstRow[x].Char.UnicodeChar = static_cast<WCHAR>(srcRow[x].ch);
+			dstRow[x].Attributes     = srcRow[x].attribs;
+
+			impl.surface.fg[rowStart + x] = expand(srcRow[x].attribs, 0);
+			impl.surface.bg[rowStart + x] = expand(srcRow[x].attribs, 4);
+		}
 	}
 
-	const BOOL result = WriteConsoleOutputA(consoleState.stdHandle,
-		consoleState.characterBuffer.data(),
-		consoleState.characterBufferSize,
-		consoleState.characterPosition,
-		&consoleState.writeArea);
-	assert(result == TRUE);
+	// Every cell was replaced, including the ones tinted by the last present.
+	impl.lastTints.count = 0;
 
-	impl.screenDirty = false;
+	impl.MarkAllRowsDirty();
+	impl.WriteToConsole();
+}
+
+bool Screen::StartRecording(const char* filename, const int keyframeInterval)
+{
+	auto& impl = *m_pImpl;
+	auto& recording = impl.recording;
+
+	if (!recording.writer.Open(filename, Width(), Height(), keyframeInterval))
+	{
+		return false;
+	}
+
+	recording.startTime = std::chrono::steady_clock::now();
+
+	return true;
+}
+
+void Screen::StopRecording()
+{
+	m_pImpl->recording.writer.Close();
+}
+
+int Screen::AddSink(std::shared_ptr<OutputSink> sink, const int maxQueuedFrames)
+{
+	auto& sinks = m_pImpl->sinks;
+
+	sinks.buffersNeeded += static_cast<std::size_t>(maxQueuedFrames) + 1;
+	sinks.ReserveBuffers(Width(), Height());
+
+	return sinks.fanout.AddSink(std::move(sink), maxQueuedFrames);
+}
+
+void Screen::RemoveSink(const int id)
+{
+	m_pImpl->sinks.fanout.RemoveSink(id);
+}
+
+SinkStats Screen::GetSinkStats(const int id) const
+{
+	return m_pImpl->sinks.fanout.Stats(id);
+}
+
+void Screen::SetEncodeThreads(const unsigned threads)
+{
+	auto& sinks = m_pImpl->sinks;
+
+	// Compared with the requested count, since ThreadCount() resolves 0 to the number of cores.
+	if (sinks.encodeThreads != threads)
+	{
+		sinks.encoder       = std::make_unique<VtParallelEncoder>(threads);
+		sinks.encodeThreads = threads;
+	}
+}
+
+bool Screen::PollResize()
+{
+	return m_pImpl->ApplyPendingResize();
+}
+
+void Screen::SetFollowWindowSize(const bool follow)
+{
+	auto& resizeWatcher = m_pImpl->resizeWatcher;
+
+	if (follow && !resizeWatcher.follow)
+	{
+		// The window is only polled once something follows it.
+		if (!resizeWatcher.thread.joinable())
+		{
+			m_pImpl->StartResizeWatcher();
+		}
+
+		// Catch up with whatever the window did in the meantime.
+		resizeWatcher.appliedSize = 0;
+	}
+
+	resizeWatcher.follow = follow;
+}
+
+void Screen::Resize(const int width, const int height)
+{
+	assert(width > 0 && height > 0);
+
+	auto& impl = *m_pImpl;
+	const COORD maximumSize = impl.resizeWatcher.maximumSize;
+
+	impl.Resize(std::min(width, static_cast<int>(maximumSize.X)), std::min(height, static_cast<int>(maximumSize.Y)));
 }
 
 void Screen::Clear()
@@ -202,12 +1283,152 @@ void Screen::Clear()
 	for (CHAR_INFO& ci : consoleState.characterBuffer)
 		ci = {};
 
-	// In case stdio is also used just do a system cls for now.
-	std::system("cls");
+	std::fill(impl.surface.fg.begin(), impl.surface.fg.end(), 0);
+	std::fill(impl.surface.bg.begin(), impl.surface.bg.end(), 0);
+	impl.tints.count     = 0;
+	impl.lastTints.count = 0;
+
+	impl.pendingScrolls.clear();
+	impl.MarkAllRowsDirty();
+
+	// In case stdio is also used, blank the whole console buffer and home the cursor.
+	// Same effect as a "cls", minus spawning a shell (and allocating) every frame.
+	CONSOLE_SCREEN_BUFFER_INFO info = {};
+	if (GetConsoleScreenBufferInfo(consoleState.stdHandle, &info))
+	{
+		const COORD origin = { 0, 0 };
+		const DWORD cellCount = static_cast<DWORD>(info.dwSize.X) * static_cast<DWORD>(info.dwSize.Y);
+		DWORD written = 0;
+
+		FillConsoleOutputCharacterW(consoleState.stdHandle, L' ', cellCount, origin, &written);
+		FillConsoleOutputAttribute(consoleState.stdHandle, info.wAttributes, cellCount, origin, &written);
+		SetConsoleCursorPosition(consoleState.stdHandle, origin);
+	}
 
 	impl.screenDirty = false;
 }
 
+void Screen::Scroll(const Point& origin, const int width, const int height, const int lines, const Colour background)
+{
+	if (!IsWithinBounds(origin) || width <= 0 || height <= 0 || lines == 0)
+	{
+		return;
+	}
+
+	auto& impl = *m_pImpl;
+	auto& consoleState = impl.consoleState;
+
+	// Anything drawn so far this frame scrolls with the rest of the area. Tinted cells are
+	// restored first, so that blended colours don't move out of the last frame's layers.
+	impl.RestoreTintedCells();
+	impl.ResolveDrawBuffer(false);
+	impl.screenDirty = true;
+
+	const int bufferW = consoleState.characterBufferSize.X;
+	const int bufferH = consoleState.characterBufferSize.Y;
+
+	// Buffer columns are shifted by one (see AddCharToBuffer). Areas touching the left edge
+	// also take the unused column 0, so that full-width areas scroll as whole lines.
+	const int left   = (origin.x == 0) ? 0 : origin.x + 1;
+	const int right  = std::min(origin.x + 1 + width, bufferW);
+	const int top    = origin.y;
+	const int bottom = std::min(origin.y + height, bufferH);
+
+	if (left >= right || top >= bottom)
+	{
+		return;
+	}
+
+	CHAR_INFO fill = {};
+	fill.Char.UnicodeChar = L' ';
+	fill.Attributes = Impl::ColourToConsoleAttributes(background, 1);
+
+	ScrollCells(consoleState.characterBuffer.data(), bufferW, left, right, top, bottom, lines, fill);
+	ScrollCells(impl.surface.fg.data(), bufferW, left, right, top, bottom, lines, std::uint32_t{ 0 });
+	ScrollCells(impl.surface.bg.data(), bufferW, left, right, top, bottom, lines, PackColour(background));
+	impl.MarkRowsDirty(top, bottom);
+
+	// Only whole lines can be scrolled by a VT terminal. Narrower areas just go through the regular diff.
+	if (left == 0 && right == bufferW)
+	{
+		VtScroll scroll;
+		scroll.top    = top;
+		scroll.bottom = bottom;
+		scroll.lines  = lines;
+		impl.pendingScrolls.push_back(scroll);
+	}
+}
+
+void Screen::Fill(const Point& origin, const int width, const int height, const Colour background)
+{
+	if (!IsWithinBounds(origin) || width <= 0 || height <= 0)
+	{
+		return;
+	}
+
+	auto& impl = *m_pImpl;
+	impl.screenDirty = true;
+
+	const Impl::CellColours colours{ 0, PackColour(background) };
+	const auto z = static_cast<std::uint16_t>(origin.z);
+
+	Impl::RunCell blanks[64];
+	for (Impl::RunCell& blank : blanks)
+	{
+		blank.ch = ' ';
+	}
+
+	const int runW   = std::min(width, Width() - origin.x);
+	const int bottom = std::min(origin.y + height, Height());
+
+	for (int y = origin.y; y < bottom; ++y)
+	{
+		for (int x = 0; x < runW; x += 64)
+		{
+			impl.AddRunToBuffer(blanks, std::min(64, runW - x), origin.x + x, y, z, colours);
+		}
+	}
+}
+
+void Screen::Tint(const Point& origin, const int width, const int height, const Colour colour, const BlendMode mode, const std::uint8_t opacity)
+{
+	if (!IsWithinBounds(origin) || width <= 0 || height <= 0 || opacity == 0)
+	{
+		return;
+	}
+
+	auto& impl = *m_pImpl;
+	impl.screenDirty = true;
+
+	// Same +1 column shift as AddCharToBuffer.
+	Impl::TintLayer tint;
+	tint.left    = origin.x + 1;
+	tint.right   = std::min(origin.x + 1 + width, Width());
+	tint.top     = origin.y;
+	tint.bottom  = std::min(origin.y + height, Height());
+	tint.z       = static_cast<std::uint16_t>(origin.z);
+	tint.colour  = PackColour(colour);
+	tint.mode    = mode;
+	tint.opacity = opacity;
+
+	if (tint.left >= tint.right || tint.top >= tint.bottom || impl.tints.count == Impl::MaxTintLayers)
+	{
+		return;
+	}
+
+	// Farthest first, layers at the same depth in call order.
+	Impl::TintLayer* const begin = impl.tints.layers.data();
+	Impl::TintLayer* const end   = begin + impl.tints.count;
+	Impl::TintLayer* const position = std::find_if(begin, end,
+		[&tint](const Impl::TintLayer& other) { return other.z < tint.z; });
+
+	std::move_backward(position, end, end + 1);
+	*position = tint;
+	++impl.tints.count;
+
+	impl.MarkRowsDirty(tint.top, tint.bottom);
+}
+
 void Screen::DrawChar(const std::uint8_t ch, const Point& position, const Colour foreground, const Colour background)
 {
 	if (!IsWithinBounds(position))
@@ -218,61 +1439,51 @@ void Screen::DrawChar(const std::uint8_t ch, const Point& position, const Colour
 	auto& impl = *m_pImpl;
 	impl.screenDirty = true;
 
-	const std::uint16_t attribs = Impl::ColourToConsoleAttributes(foreground, 0) | Impl::ColourToConsoleAttributes(background, 1);
+	const Impl::CellColours colours{ PackColour(foreground), PackColour(background) };
 
-	impl.AddCharToBuffer(ch,
+	impl.AddCharToBuffer(Cp437ToUnicode(ch),
 		static_cast<std::uint16_t>(position.x),
 		static_cast<std::uint16_t>(position.y),
 		static_cast<std::uint16_t>(position.z),
-		attribs);
+		colours);
 }
 
 void Screen::DrawText(const char* text, const Point& position, const Colour foreground, const Colour background)
 {
 	assert(text != nullptr);
+	DrawText(std::string_view{ text }, position, foreground, background);
+}
 
+void Screen::DrawText(const std::string_view text, const Point& position, const Colour foreground, const Colour background)
+{
 	if (!IsWithinBounds(position))
 	{
 		return;
 	}
 
-	auto& impl = *m_pImpl;
-	impl.screenDirty = true;
+	TextBox box;
+	box.origin   = position;
+	box.width    = Width()  - 1 - position.x; // The last column isn't usable, see AddCharToBuffer
+	box.height   = Height() - position.y;
+	box.overflow = TextOverflow::Clip;
 
-	const std::uint16_t attribs = Impl::ColourToConsoleAttributes(foreground, 0) | Impl::ColourToConsoleAttributes(background, 1);
-	auto x = static_cast<std::uint16_t>(position.x);
-	auto y = static_cast<std::uint16_t>(position.y);
-	auto z = static_cast<std::uint16_t>(position.z);
+	DrawText(text, box, foreground, background);
+}
 
-	for (int i = 0; text[i] != '\0'; ++i)
+void Screen::DrawText(const std::string_view text, const TextBox& box, const Colour foreground, const Colour background)
+{
+	if (!IsWithinBounds(box.origin) || box.width <= 0 || box.height <= 0)
 	{
-		const std::uint8_t ch = text[i];
-
-		// Handle escape characters
-		switch (ch)
-		{
-		case '\n':
-			x = static_cast<std::uint16_t>(position.x);
-			++y;
-			break;
+		return;
+	}
 
-		case '\t':
-			for (int tab = 0; tab < 4; ++tab)
-			{
-				impl.AddCharToBuffer(' ', x++, y, z, attribs);
-			}
-			break;
+	auto& impl = *m_pImpl;
+	impl.screenDirty = true;
 
-		default:
-			impl.AddCharToBuffer(ch, x++, y, z, attribs);
-			break;
-		}
-	}
-}
+	const Impl::CellColours colours{ PackColour(foreground), PackColour(background) };
 
-void Screen::DrawText(const std::string& text, const Point& position, const Colour foreground, const Colour background)
-{
-	DrawText(text.c_str(), position, foreground, background);
+	Impl::TextWriter writer{ impl, box, colours };
+	writer.Write(text);
 }
 
 void Screen::DrawRectangle(const Rectangle& rect, const Colour foreground, const Colour background)
@@ -285,15 +1496,15 @@ void Screen::DrawRectangle(const Rectangle& rect, const Colour foreground, const
 	auto& impl = *m_pImpl;
 	impl.screenDirty = true;
 
-	static constexpr std::uint8_t fills[5] = {
-		219, // Outline
-		219, // Solid
-		178, // Dither1
-		177, // Dither2
-		176, // Dither3
+	static constexpr std::uint16_t fills[5] = {
+		0x2588, // Outline
+		0x2588, // Solid
+		0x2593, // Dither1
+		0x2592, // Dither2
+		0x2591, // Dither3
 	};
 
-	const std::uint16_t attribs = Impl::ColourToConsoleAttributes(foreground, 0) | Impl::ColourToConsoleAttributes(background, 1);
+	const Impl::CellColours colours{ PackColour(foreground), PackColour(background) };
 	const auto fill = static_cast<int>(rect.fill);
 
 	auto x = static_cast<std::uint16_t>(rect.origin.x);
@@ -303,7 +1514,7 @@ void Screen::DrawRectangle(const Rectangle& rect, const Colour foreground, const
 	// Special case: handle a 1x1 rectangle as a single filled char
 	if (rect.width == 1 && rect.height == 1)
 	{
-		impl.AddCharToBuffer(fills[fill], x, y, z, attribs);
+		impl.AddCharToBuffer(fills[fill], x, y, z, colours);
 		return;
 	}
 
@@ -313,9 +1524,9 @@ void Screen::DrawRectangle(const Rectangle& rect, const Colour foreground, const
 	if (rect.fill == FillMode::Outline)
 	{
 		// horizontal/vertical lines and corners
-		static constexpr std::uint8_t borders[2][8] = {
-			{ 218, 196,  191, 179,  217, 196,  192, 179 }, // Default
-			{ 201, 205,  187, 186,  188, 205,  200, 186 }, // Double
+		static constexpr std::uint16_t borders[2][8] = {
+			{ 0x250C, 0x2500,  0x2510, 0x2502,  0x2518, 0x2500,  0x2514, 0x2502 }, // Default
+			{ 0x2554, 0x2550,  0x2557, 0x2551,  0x255D, 0x2550,  0x255A, 0x2551 }, // Double
 		};
 
 		const auto border = static_cast<int>(rect.border);
@@ -326,28 +1537,28 @@ void Screen::DrawRectangle(const Rectangle& rect, const Colour foreground, const
 		// top
 		for (i = 0; x < w; ++x, ++i)
 		{
-			impl.AddCharToBuffer(borders[border][b + (i != 0)], x, y, z, attribs);
+			impl.AddCharToBuffer(borders[border][b + (i != 0)], x, y, z, colours);
 		}
 		b += 2;
 
 		// right
 		for (i = 0; y < h; ++y, ++i)
 		{
-			impl.AddCharToBuffer(borders[border][b + (i != 0)], x, y, z, attribs);
+			impl.AddCharToBuffer(borders[border][b + (i != 0)], x, y, z, colours);
 		}
 		b += 2;
 
 		// bottom
 		for (i = 0; x > rect.origin.x; --x, ++i)
 		{
-			impl.AddCharToBuffer(borders[border][b + (i != 0)], x, y, z, attribs);
+			impl.AddCharToBuffer(borders[border][b + (i != 0)], x, y, z, colours);
 		}
 		b += 2;
 
 		// left
 		for (i = 0; y > rect.origin.y; --y, ++i)
 		{
-			impl.AddCharToBuffer(borders[border][b + (i != 0)], x, y, z, attribs);
+			impl.AddCharToBuffer(borders[border][b + (i != 0)], x, y, z, colours);
 		}
 		b += 2;
 	}
@@ -357,7 +1568,7 @@ void Screen::DrawRectangle(const Rectangle& rect, const Colour foreground, const
 		{
 			for (std::uint16_t yi = y; yi < h; ++yi)
 			{
-				impl.AddCharToBuffer(fills[fill], xi, yi, z, attribs);
+				impl.AddCharToBuffer(fills[fill], xi, yi, z, colours);
 			}
 		}
 	}
@@ -388,13 +1599,13 @@ void Screen::DrawLine(Line line, const Colour foreground, const Colour backgroun
 	auto& impl = *m_pImpl;
 	impl.screenDirty = true;
 
-	const std::uint16_t attribs = Impl::ColourToConsoleAttributes(foreground, 0) | Impl::ColourToConsoleAttributes(background, 1);
+	const Impl::CellColours colours{ PackColour(foreground), PackColour(background) };
 	const auto lineStyle = static_cast<int>(line.style);
 
-	static constexpr std::uint8_t lines[2][2] = {
+	static constexpr std::uint16_t lines[2][2] = {
 		// horizontal, vertical
-		{ 196,         179 }, // Default
-		{ 205,         186 }, // Double
+		{ 0x2500,      0x2502 }, // Default
+		{ 0x2550,      0x2551 }, // Double
 	};
 
 	auto x = static_cast<std::uint16_t>(line.start.x);
@@ -409,7 +1620,7 @@ void Screen::DrawLine(Line line, const Colour foreground, const Colour backgroun
 	{
 		for (int i = 0; i < w; ++i)
 		{
-			impl.AddCharToBuffer(lines[lineStyle][0], x++, y, z, attribs);
+			impl.AddCharToBuffer(lines[lineStyle][0], x++, y, z, colours);
 		}
 	}
 
@@ -418,7 +1629,7 @@ void Screen::DrawLine(Line line, const Colour foreground, const Colour backgroun
 	{
 		for (int i = 0; i < h; ++i)
 		{
-			impl.AddCharToBuffer(lines[lineStyle][1], x, y++, z, attribs);
+			impl.AddCharToBuffer(lines[lineStyle][1], x, y++, z, colours);
 		}
 	}
 }
@@ -483,6 +1694,10 @@ void DrawDemo(Screen& screen)
 	// Text with newlines and tabs
 	screen.DrawText("Line 1\nLine 2\tcontinues.", Point{ 8, 3 }, Colour::BrightRed, Colour::DarkGreen);
 
+	// UTF-8 text word-wrapped inside a box
+	screen.DrawText("Word-wrapped text in a box, caf\xC3\xA9 \xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E.",
+		TextBox{ { 40, 3 }, 14, 4, TextOverflow::WordWrap }, Colour::White, Colour::DarkBlue);
+
 	// Lines
 	screen.DrawLine(Line{ { 30, 3 }, { 36, 3 }, LineStyle::Default }, Colour::BrightRed,  Colour::Black);
 	screen.DrawLine(Line{ { 30, 4 }, { 30, 8 }, LineStyle::Default }, Colour::BrightBlue, Colour::Black);
@@ -514,6 +1729,9 @@ void DrawDemo(Screen& screen)
 	screen.DrawRectangle(Rectangle{ { 48, 20 }, 1, 1,   LineStyle::Default, FillMode::Dither3 }, Colour::White, Colour::Black);
 	screen.DrawRectangle(Rectangle{ { 48, 22 }, 2, 2,   LineStyle::Default, FillMode::Dither3 }, Colour::White, Colour::Black);
 	screen.DrawRectangle(Rectangle{ { 48, 24 }, 10, 10, LineStyle::Default, FillMode::Dither3 }, Colour::White, Colour::Black);
+
+	// Translucent overlay across the rectangles
+	screen.Tint(Point{ 14, 13 }, 24, 4, Colour::BrightBlue, BlendMode::Alpha, 128);
 }
 
 } // namespace console
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <cstdint>
-#include <string>
+#include <string_view>
 #include <memory>
 
 namespace console
@@ -48,6 +48,29 @@ struct Line
 	LineStyle style = LineStyle::Default;
 };
 
+enum class TextOverflow : std::uint8_t
+{
+	Clip,     // Lines wider than the box are cut off
+	WordWrap, // Lines break between words, words wider than the box are split
+};
+
+struct TextBox
+{
+	Point origin;
+
+	int width  = 0;
+	int height = 0;
+
+	TextOverflow overflow = TextOverflow::Clip;
+};
+
+enum class BlendMode : std::uint8_t
+{
+	Alpha,    // Mix towards the colour
+	Multiply, // Darken by the colour, e.g. drop shadows
+	Add,      // Brighten by the colour, e.g. highlights
+};
+
 struct Colour
 {
 	std::uint8_t r = 0;
@@ -65,26 +88,92 @@ struct Colour
 	static const Colour DarkBlue;
 };
 
+struct FrameCell;
+class OutputSink;
+struct SinkStats;
+
 // Helper class to draw characters, strings and simple geometric shaped to the console screen.
 // All draws are buffered until Present() is called.
+// Once the first frame has been presented, drawing and presenting don't allocate memory,
+// unless the screen is resized, a sink is added or the frame log index has to grow.
 class Screen final
 {
 public:
 
 	Screen(const char* title, const int width, const int height);
+	~Screen();
+
+	// Move-only, the Screen owns the console state.
+	Screen(Screen&&) noexcept;
+	Screen& operator=(Screen&&) noexcept;
 
 	// Presents all draws to the console screen.
 	void Present();
 
+	// Presents pre-built cells (e.g. decoded by a FrameReader), bypassing the draw buffer.
+	// Cells outside the screen are clipped.
+	void PresentCells(const FrameCell* cells, const int width, const int height);
+
+	// Records every presented frame to a binary frame log (see FrameLog.h).
+	// Returns false if the file can't be created.
+	bool StartRecording(const char* filename, const int keyframeInterval = 120);
+	void StopRecording();
+
+	// Mirrors presented frames to an extra output (log file, pipe watcher, etc), on top of the console.
+	// Frames are VT-encoded once and shared by all sinks, each written from its own thread.
+	// A sink more than maxQueuedFrames behind drops frames and catches up with a full repaint.
+	// Returns an id for RemoveSink()/GetSinkStats().
+	int  AddSink(std::shared_ptr<OutputSink> sink, const int maxQueuedFrames = 4);
+	void RemoveSink(const int id);
+	SinkStats GetSinkStats(const int id) const;
+
+	// Encodes the frames for the sinks in horizontal bands of rows, on this many threads
+	// (0 = one per hardware core). The bytes sent are the same; 1, the default, encodes on the calling thread.
+	void SetEncodeThreads(const unsigned threads);
+
 	// Clears the screen.
 	void Clear();
 
-	// Draw single ASCII character.
+	// While following the window size (see SetFollowWindowSize()), console window resizes are
+	// detected in the background and applied by Present(), keeping the overlapping content.
+	// Call PollResize() before drawing to apply a pending resize right away; returns true if
+	// the size changed, so the caller can redo its layout.
+	bool PollResize();
+
+	// Starts (true) or stops (false) following the console window size. Off by default: the screen
+	// keeps the size it was created with, and only changes through Resize(). Starting applies the
+	// current window size on the next Present().
+	void SetFollowWindowSize(const bool follow);
+
+	// Explicitly resizes the screen (clamped to the maximum console size), keeping the overlapping content.
+	void Resize(const int width, const int height);
+
+	// Scrolls the content of a width x height area up (lines > 0) or down (lines < 0),
+	// including anything already drawn this frame. Uncovered lines are cleared to the background colour.
+	// Mirrored outputs get full-width areas as terminal scroll sequences, so only the new lines are sent.
+	void Scroll(const Point& origin, const int width, const int height, const int lines, const Colour background);
+
+	// Fills a width x height area with blanks of the background colour.
+	void Fill(const Point& origin, const int width, const int height, const Colour background);
+
+	// Blends a colour over the foreground and background of a width x height area, at opacity/255,
+	// like a translucent layer at depth origin.z: only cells at the same depth or behind it are
+	// affected, whatever the draw order. Cells not drawn this frame are behind every layer.
+	// A layer only lasts for the frame it's added in (up to 16 per frame, further ones are ignored):
+	// it's blended over the untinted colours when presented, after any Scroll(), and undone by
+	// the next present. Colours are blended in RGB, then reduced to the 16 console colours.
+	void Tint(const Point& origin, const int width, const int height, const Colour colour, const BlendMode mode, const std::uint8_t opacity);
+
+	// Draw single character, from code page 437 (ASCII plus the box drawing and shading characters).
 	void DrawChar(const std::uint8_t ch, const Point& position, const Colour foreground, const Colour background);
 
-	// Draw string (handles newlines '\n' and tabs '\t').
+	// Draw UTF-8 string (handles newlines '\n' and tabs '\t'), clipped to the screen.
+	// East Asian wide characters take two cells, combining marks are dropped.
 	void DrawText(const char* text, const Point& position, const Colour foreground, const Colour background);
-	void DrawText(const std::string& text, const Point& position, const Colour foreground, const Colour background);
+	void DrawText(const std::string_view text, const Point& position, const Colour foreground, const Colour background);
+
+	// Draw UTF-8 string inside a box, clipped or word-wrapped to its width and clipped to its height.
+	void DrawText(const std::string_view text, const TextBox& box, const Colour foreground, const Colour background);
 
 	// Draw shapes.
 	void DrawRectangle(const Rectangle& rect, const Colour foreground, const Colour background);
@@ -99,7 +188,7 @@ public:
 private:
 
 	struct Impl;
-	const std::shared_ptr<Impl> m_pImpl;
+	std::unique_ptr<Impl> m_pImpl;
 };
 
 void Wait(unsigned int milliseconds);
@@ -0,0 +1,254 @@
+#include "SelfPlay.h"
+#include "Game.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace game
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// A move takes a few dozen nanoseconds, about as long as reading the clock. Moves are
+// timed in batches of this many games instead, each batch recording its mean move latency.
+constexpr std::uint64_t GamesPerLatencySample = 64;
+
+// Log-linear latency histogram: 16 sub-buckets per power of two, so any
+// recorded value is reported with at most ~6% error, in constant memory.
+class LatencyHistogram final
+{
+public:
+
+	void Record(const std::uint64_t nanoseconds)
+	{
+		++m_buckets[BucketIndex(nanoseconds)];
+		++m_count;
+		m_max = std::max(m_max, nanoseconds);
+	}
+
+	void Merge(const LatencyHistogram& other)
+	{
+		for (std::size_t i = 0; i < m_buckets.size(); ++i)
+		{
+			m_buckets[i] += other.m_buckets[i];
+		}
+
+		m_count += other.m_count;
+		m_max = std::max(m_max, other.m_max);
+	}
+
+	double Percentile(const double p) const
+	{
+		if (m_count == 0)
+		{
+			return 0.0;
+		}
+
+		const auto target = static_cast<std::uint64_t>(p * static_cast<double>(m_count - 1)) + 1;
+		std::uint64_t seen = 0;
+
+		for (std::size_t i = 0; i < m_buckets.size(); ++i)
+		{
+			seen += m_buckets[i];
+			if (seen >= target)
+			{
+				return static_cast<double>(std::min(BucketUpperBound(i), m_max));
+			}
+		}
+
+		return static_cast<double>(m_max);
+	}
+
+	double Max() const { return static_cast<double>(m_max); }
+
+private:
+
+	static constexpr int SubBucketBits = 4;
+	static constexpr int SubBuckets    = 1 << SubBucketBits;
+
+	static std::size_t BucketIndex(const std::uint64_t value)
+	{
+		if (value < SubBuckets)
+		{
+			return static_cast<std::size_t>(value);
+		}
+
+		int msb = 63;
+		while ((value >> msb) == 0)
+		{
+			--msb;
+		}
+
+		const int shift = msb - SubBucketBits;
+		const auto sub  = static_cast<std::size_t>((value >> shift) & (SubBuckets - 1));
+		return static_cast<std::size_t>(shift + 1) * SubBuckets + sub;
+	}
+
+	static std::uint64_t BucketUpperBound(const std::size_t index)
+	{
+		if (index < SubBuckets)
+		{
+			return index;
+		}
+
+		const auto shift = static_cast<int>(index / SubBuckets) - 1;
+		const auto sub   = static_cast<std::uint64_t>(index % SubBuckets) | SubBuckets;
+		return ((sub + 1) << shift) - 1;
+	}
+
+	std::array<std::uint64_t, 61 * SubBuckets> m_buckets = {};
+	std::uint64_t m_count = 0;
+	std::uint64_t m_max   = 0;
+};
+
+struct WorkerResults
+{
+	std::uint64_t games      = 0;
+	std::uint64_t moves      = 0;
+	std::uint64_t playerWins = 0;
+	std::uint64_t aiWins     = 0;
+	std::uint64_t ties       = 0;
+	LatencyHistogram latency;
+};
+
+void PlayGames(const std::uint64_t games, const std::uint64_t seed, WorkerResults& output)
+{
+	// Accumulate locally and publish once at the end to avoid false sharing between workers.
+	WorkerResults results;
+	Random random{ seed };
+	Board board;
+
+	auto          sampleStart = Clock::now();
+	std::uint64_t sampleMoves = 0;
+
+	for (std::uint64_t g = 0; g < games; ++g)
+	{
+		board.Reset();
+
+		// Same rules as the interactive game: 'X' moves first, then 'O'.
+		char turn = PlayerCharacter;
+		Outcome outcome = Outcome::InProgress;
+
+		while (outcome == Outcome::InProgress)
+		{
+			const Move move = ChooseAIMove(board, random);
+			board.Play(move, turn);
+			outcome = board.Evaluate();
+
+			++results.moves;
+			++sampleMoves;
+			turn = (turn == PlayerCharacter) ? AICharacter : PlayerCharacter;
+		}
+
+		switch (outcome)
+		{
+		case Outcome::PlayerWins: ++results.playerWins; break;
+		case Outcome::AIWins:     ++results.aiWins;     break;
+		default:                  ++results.ties;       break;
+		}
+
+		++results.games;
+
+		if (results.games % GamesPerLatencySample == 0 || g + 1 == games)
+		{
+			const auto now = Clock::now();
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - sampleStart).count();
+
+			results.latency.Record(static_cast<std::uint64_t>(elapsed) / sampleMoves);
+			sampleStart = now;
+			sampleMoves = 0;
+		}
+	}
+
+	output = results;
+}
+
+double Percent(const std::uint64_t part, const std::uint64_t total)
+{
+	return (total != 0) ? (100.0 * static_cast<double>(part) / static_cast<double>(total)) : 0.0;
+}
+
+} // namespace
+
+SelfPlayResults RunSelfPlay(const SelfPlaySettings& settings)
+{
+	unsigned threadCount = settings.threads;
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Each worker owns its RNG and gets a fixed slice of the games.
+	std::vector<WorkerResults> workerResults(threadCount);
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount);
+
+	const auto start = Clock::now();
+
+	for (unsigned t = 0; t < threadCount; ++t)
+	{
+		const std::uint64_t games = (settings.games / threadCount) + (t < (settings.games % threadCount) ? 1 : 0);
+		const std::uint64_t seed  = settings.seed + t;
+
+		workers.emplace_back(PlayGames, games, seed, std::ref(workerResults[t]));
+	}
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	const auto end = Clock::now();
+
+	SelfPlayResults results;
+	results.threads = threadCount;
+	results.seconds = std::chrono::duration<double>(end - start).count();
+
+	LatencyHistogram latency;
+	for (const WorkerResults& worker : workerResults)
+	{
+		results.games      += worker.games;
+		results.moves      += worker.moves;
+		results.playerWins += worker.playerWins;
+		results.aiWins     += worker.aiWins;
+		results.ties       += worker.ties;
+		latency.Merge(worker.latency);
+	}
+
+	results.latencyP50 = latency.Percentile(0.50);
+	results.latencyP90 = latency.Percentile(0.90);
+	results.latencyP99 = latency.Percentile(0.99);
+	results.latencyMax = latency.Max();
+
+	return results;
+}
+
+void PrintSelfPlayResults(const SelfPlayResults& results)
+{
+	const double gamesPerSecond = (results.seconds > 0.0) ? (static_cast<double>(results.games) / results.seconds) : 0.0;
+
+	std::printf("Self-play: %llu games, %llu moves, %u threads, %.3f s\n",
+		static_cast<unsigned long long>(results.games),
+		static_cast<unsigned long long>(results.moves),
+		results.threads, results.seconds);
+
+	std::printf("Throughput: %.0f games/s\n", gamesPerSecond);
+
+	std::printf("X wins: %.2f%%  O wins: %.2f%%  Ties: %.2f%%\n",
+		Percent(results.playerWins, results.games),
+		Percent(results.aiWins,     results.games),
+		Percent(results.ties,       results.games));
+
+	std::printf("Move latency (ns): p50=%.0f p90=%.0f p99=%.0f max=%.0f\n",
+		results.latencyP50, results.latencyP90, results.latencyP99, results.latencyMax);
+}
+
+} // namespace game
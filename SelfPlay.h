@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+namespace game
+{
+
+struct SelfPlaySettings
+{
+	std::uint64_t games   = 1000000;
+	unsigned      threads = 0; // 0 = one per hardware core
+	std::uint64_t seed    = 1;
+};
+
+struct SelfPlayResults
+{
+	std::uint64_t games      = 0;
+	std::uint64_t moves      = 0;
+	std::uint64_t playerWins = 0; // 'X' side, moves first
+	std::uint64_t aiWins     = 0; // 'O' side
+	std::uint64_t ties       = 0;
+	unsigned      threads    = 0;
+	double        seconds    = 0.0;
+
+	// Move latency percentiles, in nanoseconds. Moves are timed in batches of 64 games,
+	// so these are over the mean move latency of each batch.
+	double latencyP50 = 0.0;
+	double latencyP90 = 0.0;
+	double latencyP99 = 0.0;
+	double latencyMax = 0.0;
+};
+
+// Headless AI vs AI benchmark: plays games in parallel, one RNG per thread,
+// without touching the console. Results are deterministic for a given seed
+// and thread count, apart from the timings.
+SelfPlayResults RunSelfPlay(const SelfPlaySettings& settings);
+
+// Prints a human readable summary to stdout.
+void PrintSelfPlayResults(const SelfPlayResults& results);
+
+} // namespace game
@@ -0,0 +1,188 @@
+#include "Unicode.h"
+
+#include <array>
+
+namespace console
+{
+
+namespace
+{
+
+struct Range
+{
+	char32_t first;
+	char32_t last;
+};
+
+// Combining marks, joiners and other characters that don't advance the cursor (common blocks).
+constexpr Range zeroWidthRanges[] = {
+	{ 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF }, { 0x05C1, 0x05C2 },
+	{ 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A }, { 0x064B, 0x065F }, { 0x0670, 0x0670 },
+	{ 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 }, { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 },
+	{ 0x0730, 0x074A }, { 0x07A6, 0x07B0 }, { 0x07EB, 0x07F3 }, { 0x0816, 0x0819 }, { 0x081B, 0x0823 },
+	{ 0x0825, 0x0827 }, { 0x0829, 0x082D }, { 0x0900, 0x0902 }, { 0x093A, 0x093A }, { 0x093C, 0x093C },
+	{ 0x0941, 0x0948 }, { 0x094D, 0x094D }, { 0x0951, 0x0957 }, { 0x0962, 0x0963 }, { 0x0981, 0x0981 },
+	{ 0x09BC, 0x09BC }, { 0x09C1, 0x09C4 }, { 0x09CD, 0x09CD }, { 0x09E2, 0x09E3 }, { 0x0A01, 0x0A02 },
+	{ 0x0A3C, 0x0A3C }, { 0x0A41, 0x0A42 }, { 0x0A47, 0x0A48 }, { 0x0A4B, 0x0A4D }, { 0x0A70, 0x0A71 },
+	{ 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E }, { 0x0EB1, 0x0EB1 }, { 0x0EB4, 0x0EBC },
+	{ 0x0EC8, 0x0ECD }, { 0x1160, 0x11FF }, { 0x200B, 0x200F }, { 0x202A, 0x202E }, { 0x2060, 0x2064 },
+	{ 0x20D0, 0x20F0 }, { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF },
+};
+
+// East Asian Wide and Fullwidth characters, plus emoji presentation symbols.
+constexpr Range wideRanges[] = {
+	{ 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC }, { 0x23F0, 0x23F0 },
+	{ 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 }, { 0x2648, 0x2653 }, { 0x267F, 0x267F },
+	{ 0x2693, 0x2693 }, { 0x26A1, 0x26A1 }, { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 },
+	{ 0x26CE, 0x26CE }, { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+	{ 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B }, { 0x2728, 0x2728 },
+	{ 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 }, { 0x2757, 0x2757 }, { 0x2795, 0x2797 },
+	{ 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF }, { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 },
+	{ 0x2E80, 0x303E }, { 0x3041, 0x33FF }, { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF },
+	{ 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 }, { 0xFE30, 0xFE6F },
+	{ 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 }, { 0x1F300, 0x1F64F }, { 0x1F900, 0x1F9FF }, { 0x20000, 0x2FFFD },
+	{ 0x30000, 0x3FFFD },
+};
+
+template<std::size_t N>
+bool InRanges(const Range (&ranges)[N], const char32_t codePoint)
+{
+	// Ranges are sorted, binary search.
+	std::size_t lo = 0;
+	std::size_t hi = N;
+
+	while (lo < hi)
+	{
+		const std::size_t mid = (lo + hi) / 2;
+		if (codePoint < ranges[mid].first)
+		{
+			hi = mid;
+		}
+		else if (codePoint > ranges[mid].last)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int ComputeWidth(const char32_t codePoint)
+{
+	if (InRanges(zeroWidthRanges, codePoint))
+	{
+		return 0;
+	}
+
+	return InRanges(wideRanges, codePoint) ? 2 : 1;
+}
+
+// 2 bits per BMP code point (16KB), so the common case is a single load and shift.
+class WidthTable final
+{
+public:
+
+	WidthTable()
+	{
+		for (char32_t cp = 0; cp < 0x10000; ++cp)
+		{
+			m_bits[cp >> 2] |= static_cast<std::uint8_t>(ComputeWidth(cp) << ((cp & 3) * 2));
+		}
+	}
+
+	int Lookup(const char32_t codePoint) const
+	{
+		return (m_bits[codePoint >> 2] >> ((codePoint & 3) * 2)) & 3;
+	}
+
+private:
+
+	std::array<std::uint8_t, 0x10000 / 4> m_bits = {};
+};
+
+// Unicode code points for the upper half of code page 437 (box drawing, shades, etc).
+constexpr std::uint16_t cp437High[128] = {
+	0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7, 0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+	0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9, 0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+	0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA, 0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+	0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556, 0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+	0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F, 0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+	0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B, 0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+	0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4, 0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+	0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248, 0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0,
+};
+
+} // namespace
+
+char32_t DecodeUtf8(const std::string_view text, std::size_t& index)
+{
+	const auto lead = static_cast<std::uint8_t>(text[index]);
+
+	if (lead < 0x80)
+	{
+		++index;
+		return lead;
+	}
+
+	int length = 0;
+	char32_t codePoint = 0;
+	char32_t minimum = 0;
+
+	if ((lead & 0xE0) == 0xC0)      { length = 2; codePoint = lead & 0x1F; minimum = 0x80;    }
+	else if ((lead & 0xF0) == 0xE0) { length = 3; codePoint = lead & 0x0F; minimum = 0x800;   }
+	else if ((lead & 0xF8) == 0xF0) { length = 4; codePoint = lead & 0x07; minimum = 0x10000; }
+	else
+	{
+		++index;
+		return ReplacementCharacter;
+	}
+
+	if (index + length > text.size())
+	{
+		++index;
+		return ReplacementCharacter;
+	}
+
+	for (int i = 1; i < length; ++i)
+	{
+		const auto next = static_cast<std::uint8_t>(text[index + i]);
+		if ((next & 0xC0) != 0x80)
+		{
+			++index;
+			return ReplacementCharacter;
+		}
+		codePoint = (codePoint << 6) | (next & 0x3F);
+	}
+
+	// Reject overlong encodings, surrogates and out of range values.
+	if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+	{
+		++index;
+		return ReplacementCharacter;
+	}
+
+	index += length;
+	return codePoint;
+}
+
+int CharWidth(const char32_t codePoint)
+{
+	if (codePoint < 0x10000)
+	{
+		static const WidthTable table;
+		return table.Lookup(codePoint);
+	}
+
+	return ComputeWidth(codePoint);
+}
+
+std::uint16_t Cp437ToUnicode(const std::uint8_t ch)
+{
+	return (ch < 0x80) ? ch : cp437High[ch - 0x80];
+}
+
+} // namespace console
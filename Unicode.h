@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace console
+{
+
+constexpr char32_t ReplacementCharacter = 0xFFFD;
+
+// Decodes the UTF-8 sequence starting at text[index] and advances index past it.
+// Invalid or truncated sequences decode as U+FFFD and consume a single byte.
+char32_t DecodeUtf8(const std::string_view text, std::size_t& index);
+
+// Number of console cells a code point takes: 0 for combining marks and other
+// zero-width characters, 2 for East Asian Wide/Fullwidth, 1 otherwise.
+// Code points in the BMP are looked up in a table built on first use.
+int CharWidth(const char32_t codePoint);
+
+// Code page 437 (the console's default OEM code page) to Unicode, for the box drawing
+// and shading characters taken by DrawChar().
+std::uint16_t Cp437ToUnicode(const std::uint8_t ch);
+
+} // namespace console
@@ -0,0 +1,500 @@
+#include "VtEncoder.h"
+#include "FrameLog.h"
+#include "CellBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace console
+{
+
+namespace
+{
+
+// Starts a full repaint: reset attributes, clear screen, hide the cursor.
+constexpr char RepaintPrefix[] = "\x1B[0m\x1B[2J\x1B[?25l";
+
+// Win32 console attribute bits (FOREGROUND_RED, etc) to ANSI colour bits (red=1, green=2, blue=4).
+constexpr std::uint8_t ansiColour[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+class VtWriter final
+{
+public:
+
+	explicit VtWriter(std::vector<std::uint8_t>& out)
+		: m_out{ out }
+	{ }
+
+	void Raw(const char* str)
+	{
+		Append(str, std::strlen(str));
+	}
+
+	std::size_t Size() const { return m_out.size(); }
+
+	// CSI <params> <final>, e.g. CSI 3;10 r
+	void Csi(const int param0, const int param1, const char final)
+	{
+		char buf[32];
+		int n = 0;
+		buf[n++] = '\x1B';
+		buf[n++] = '[';
+		n += FormatInt(buf + n, param0);
+		if (param1 >= 0)
+		{
+			buf[n++] = ';';
+			n += FormatInt(buf + n, param1);
+		}
+		buf[n++] = final;
+		Append(buf, static_cast<std::size_t>(n));
+	}
+
+	void MoveTo(const int x, const int y)
+	{
+		if (x == m_cursorX && y == m_cursorY)
+		{
+			return;
+		}
+
+		// CUP is 1-based
+		Csi(y + 1, x + 1, 'H');
+
+		m_cursorX = x;
+		m_cursorY = y;
+	}
+
+	void SetAttributes(const std::uint16_t attribs)
+	{
+		if (m_attribsValid && attribs == m_attribs)
+		{
+			return;
+		}
+
+		const int fg = ansiColour[attribs & 0x7];
+		const int bg = ansiColour[(attribs >> 4) & 0x7];
+		const bool fgBright = (attribs & 0x08) != 0;
+		const bool bgBright = (attribs & 0x80) != 0;
+
+		char buf[16];
+		int n = 0;
+		buf[n++] = '\x1B';
+		buf[n++] = '[';
+		n += FormatInt(buf + n, (fgBright ? 90 : 30) + fg);
+		buf[n++] = ';';
+		n += FormatInt(buf + n, (bgBright ? 100 : 40) + bg);
+		buf[n++] = 'm';
+		Append(buf, static_cast<std::size_t>(n));
+
+		m_attribs = attribs;
+		m_attribsValid = true;
+	}
+
+	// cellWidth is 2 for double-width characters, which advance the terminal cursor by two columns.
+	// trail is the character of the trailing half, only used when cellWidth is 2.
+	void PutChar(const std::uint16_t ch, const std::uint16_t trail, const int cellWidth, const int width)
+	{
+		char utf8[4];
+		const int size = (cellWidth == 2) ? ConsoleCharToUtf8(ch, trail, utf8) : ConsoleCharToUtf8(ch, utf8);
+		Append(utf8, static_cast<std::size_t>(size));
+
+		// Writing the last column leaves the terminal in a "pending wrap" state,
+		// so don't trust the cursor position until the next explicit move.
+		m_cursorX += cellWidth;
+		if (m_cursorX >= width)
+		{
+			m_cursorX = -1;
+			m_cursorY = -1;
+		}
+	}
+
+private:
+
+	void Append(const char* data, const std::size_t size)
+	{
+		m_out.insert(m_out.end(), data, data + size);
+	}
+
+	static int FormatInt(char* buf, int value)
+	{
+		assert(value >= 0);
+
+		char digits[12];
+		int count = 0;
+		do
+		{
+			digits[count++] = static_cast<char>('0' + (value % 10));
+			value /= 10;
+		} while (value != 0);
+
+		for (int i = 0; i < count; ++i)
+		{
+			buf[i] = digits[count - 1 - i];
+		}
+		return count;
+	}
+
+	std::vector<std::uint8_t>& m_out;
+	int           m_cursorX      = -1;
+	int           m_cursorY      = -1;
+	std::uint16_t m_attribs      = 0;
+	bool          m_attribsValid = false;
+};
+
+// What a run of rows sent, for joining separately encoded bands.
+struct RowsSummary
+{
+	bool          sent         = false; // Any cell sent
+	std::size_t   sgrBegin     = 0;     // Bytes of the SGR sent for the first cell
+	std::size_t   sgrEnd       = 0;
+	std::uint16_t firstAttribs = 0;     // Attributes of the first and last cells sent
+	std::uint16_t lastAttribs  = 0;
+};
+
+RowsSummary EncodeRows(VtWriter& writer, const FrameCell* cells, const FrameCell* previous, const int width, const int top, const int bottom)
+{
+	RowsSummary summary;
+
+	for (int y = top; y < bottom; ++y)
+	{
+		const FrameCell* row = cells + (y * width);
+		const FrameCell* prevRow = (previous != nullptr) ? (previous + (y * width)) : nullptr;
+
+		for (int x = 0; x < width; ++x)
+		{
+			// A double-width character is sent once, from its leading half, and is resent
+			// if either half changed. The terminal fills the trailing cell itself.
+			const bool wide = (row[x].attribs & CellLeadingHalf) != 0 && x + 1 < width && (row[x + 1].attribs & CellTrailingHalf) != 0;
+			const int cellWidth = wide ? 2 : 1;
+
+			if (prevRow != nullptr && row[x] == prevRow[x] && (!wide || row[x + 1] == prevRow[x + 1]))
+			{
+				x += cellWidth - 1;
+				continue;
+			}
+
+			const auto attribs = static_cast<std::uint16_t>(row[x].attribs & CellColourMask);
+
+			writer.MoveTo(x, y);
+
+			if (!summary.sent)
+			{
+				summary.sent         = true;
+				summary.sgrBegin     = writer.Size();
+				summary.firstAttribs = attribs;
+				writer.SetAttributes(attribs);
+				summary.sgrEnd       = writer.Size();
+			}
+			else
+			{
+				writer.SetAttributes(attribs);
+			}
+			summary.lastAttribs = attribs;
+
+			// A half without its other half (e.g. clipped or overdrawn) would misplace the cursor, blank it.
+			const bool orphan = !wide && (row[x].attribs & (CellLeadingHalf | CellTrailingHalf)) != 0;
+			writer.PutChar(orphan ? ' ' : row[x].ch, wide ? row[x + 1].ch : 0, cellWidth, width);
+
+			x += cellWidth - 1;
+		}
+	}
+
+	return summary;
+}
+
+int CodePointToUtf8(const char32_t cp, char utf8[4])
+{
+	if (cp < 0x80)
+	{
+		utf8[0] = static_cast<char>(cp);
+		return 1;
+	}
+	if (cp < 0x800)
+	{
+		utf8[0] = static_cast<char>(0xC0 | (cp >> 6));
+		utf8[1] = static_cast<char>(0x80 | (cp & 0x3F));
+		return 2;
+	}
+
+	if (cp < 0x10000)
+	{
+		utf8[0] = static_cast<char>(0xE0 | (cp >> 12));
+		utf8[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		utf8[2] = static_cast<char>(0x80 | (cp & 0x3F));
+		return 3;
+	}
+
+	utf8[0] = static_cast<char>(0xF0 | (cp >> 18));
+	utf8[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+	utf8[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+	utf8[3] = static_cast<char>(0x80 | (cp & 0x3F));
+	return 4;
+}
+
+} // namespace
+
+int ConsoleCharToUtf8(const std::uint16_t ch, char utf8[4])
+{
+	std::uint32_t cp = ch;
+
+	if (ch < 0x20 || ch == 0x7F)
+	{
+		cp = ' '; // Null/control characters are drawn as blanks
+	}
+	else if (ch >= 0xD800 && ch <= 0xDFFF)
+	{
+		cp = 0xFFFD; // A surrogate on its own can't be encoded
+	}
+
+	return CodePointToUtf8(cp, utf8);
+}
+
+int ConsoleCharToUtf8(const std::uint16_t lead, const std::uint16_t trail, char utf8[4])
+{
+	if (lead >= 0xD800 && lead <= 0xDBFF && trail >= 0xDC00 && trail <= 0xDFFF)
+	{
+		return CodePointToUtf8(0x10000 + ((static_cast<char32_t>(lead) - 0xD800) << 10) + (trail - 0xDC00), utf8);
+	}
+
+	return ConsoleCharToUtf8(lead, utf8);
+}
+
+void EncodeVtScroll(const VtScroll& scroll, FrameCell* previous, const int width, const int height, std::vector<std::uint8_t>& out)
+{
+	assert(previous != nullptr);
+
+	const int top    = std::max(scroll.top, 0);
+	const int bottom = std::min(scroll.bottom, height);
+	const int lines  = std::max(std::min(scroll.lines, bottom - top), top - bottom);
+
+	if (top >= bottom || lines == 0)
+	{
+		return;
+	}
+
+	VtWriter writer{ out };
+
+	// DECSTBM (1-based, inclusive) + SU/SD, then reset the margins. Both move the cursor,
+	// which is fine since every frame starts from an unknown cursor position anyway.
+	writer.Csi(top + 1, bottom, 'r');
+	writer.Csi((lines > 0) ? lines : -lines, -1, (lines > 0) ? 'S' : 'T');
+	writer.Raw("\x1B[r");
+
+	// The terminal fills the new lines with whatever background is current,
+	// so mark them as unknown to make sure the delta repaints them.
+	FrameCell unknown;
+	unknown.ch      = 0xFFFF;
+	unknown.attribs = 0xFFFF;
+
+	ScrollCells(previous, width, 0, width, top, bottom, lines, unknown);
+}
+
+void EncodeVtFrame(const FrameCell* cells, const FrameCell* previous, const int width, const int height, std::vector<std::uint8_t>& out)
+{
+	assert(cells != nullptr);
+	assert(width > 0 && height > 0);
+
+	VtWriter writer{ out };
+
+	if (previous == nullptr)
+	{
+		writer.Raw(RepaintPrefix);
+	}
+
+	EncodeRows(writer, cells, previous, width, 0, height);
+}
+
+// Each band is encoded by a fresh VtWriter, so it starts with an unknown cursor and unknown attributes.
+// The cursor doesn't matter: the serial encoder's cursor is always on an earlier row (or unknown)
+// when it reaches a new band, so the first cell sent always gets a CUP either way. The attributes
+// do: the band's first SGR is dropped when joining if the previous bands left the same attributes.
+struct VtParallelEncoder::Impl
+{
+	struct Band
+	{
+		int                       top    = 0;
+		int                       bottom = 0;
+		std::vector<std::uint8_t> bytes;
+		RowsSummary               summary;
+	};
+
+	std::vector<Band>        bands;   // bands[0] is encoded by the calling thread, bands[i] by workers[i - 1]
+	std::vector<std::thread> workers;
+
+	// Everything below is guarded by mutex.
+	std::mutex              mutex;
+	std::condition_variable wakeUp;   // Workers: a new frame or stop
+	std::condition_variable finished; // Caller: all bands done
+	std::uint64_t           frame     = 0;
+	int                     bandCount = 0;
+	int                     pending   = 0;
+	bool                    stop      = false;
+
+	// Current frame, only read by workers between wakeUp and finished.
+	const FrameCell* cells    = nullptr;
+	const FrameCell* previous = nullptr;
+	int              width    = 0;
+
+	void EncodeBand(Band& band)
+	{
+		band.bytes.clear();
+		VtWriter writer{ band.bytes };
+		band.summary = EncodeRows(writer, cells, previous, width, band.top, band.bottom);
+	}
+
+	void Run(const int index)
+	{
+		std::uint64_t lastFrame = 0;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				wakeUp.wait(lock, [&] { return stop || frame != lastFrame; });
+
+				if (stop)
+				{
+					return;
+				}
+
+				lastFrame = frame;
+
+				if (index >= bandCount)
+				{
+					continue;
+				}
+			}
+
+			EncodeBand(bands[index]);
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (--pending == 0)
+			{
+				finished.notify_one();
+			}
+		}
+	}
+};
+
+VtParallelEncoder::VtParallelEncoder(unsigned threads)
+	: m_pImpl{ std::make_unique<Impl>() }
+{
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	auto& impl = *m_pImpl;
+	impl.bands.resize(threads);
+	impl.workers.reserve(threads - 1);
+
+	for (unsigned i = 1; i < threads; ++i)
+	{
+		impl.workers.emplace_back([&impl, i] { impl.Run(static_cast<int>(i)); });
+	}
+}
+
+VtParallelEncoder::~VtParallelEncoder()
+{
+	auto& impl = *m_pImpl;
+
+	{
+		std::lock_guard<std::mutex> lock{ impl.mutex };
+		impl.stop = true;
+	}
+	impl.wakeUp.notify_all();
+
+	for (std::thread& worker : impl.workers)
+	{
+		worker.join();
+	}
+}
+
+unsigned VtParallelEncoder::ThreadCount() const
+{
+	return static_cast<unsigned>(m_pImpl->bands.size());
+}
+
+void VtParallelEncoder::Encode(const FrameCell* cells, const FrameCell* previous, const int width, const int height, std::vector<std::uint8_t>& out)
+{
+	assert(cells != nullptr);
+	assert(width > 0 && height > 0);
+
+	auto& impl = *m_pImpl;
+
+	// Small frames aren't worth waking the workers for.
+	const int maxBands  = std::max(1, (width * height) / MinCellsPerBand);
+	const int bandCount = std::min({ static_cast<int>(impl.bands.size()), maxBands, height });
+
+	if (bandCount == 1)
+	{
+		EncodeVtFrame(cells, previous, width, height, out);
+		return;
+	}
+
+	// Fixed boundaries, so that the bands only depend on the frame size.
+	for (int i = 0; i < bandCount; ++i)
+	{
+		Impl::Band& band = impl.bands[i];
+		band.top    = (height * i) / bandCount;
+		band.bottom = (height * (i + 1)) / bandCount;
+
+		// Same worst case per cell as the sinks' buffers. Only allocates when the frame grows.
+		band.bytes.reserve(static_cast<std::size_t>(width) * (band.bottom - band.top) * 24);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ impl.mutex };
+		impl.cells     = cells;
+		impl.previous  = previous;
+		impl.width     = width;
+		impl.bandCount = bandCount;
+		impl.pending   = bandCount - 1;
+		++impl.frame;
+	}
+	impl.wakeUp.notify_all();
+
+	impl.EncodeBand(impl.bands[0]);
+
+	{
+		std::unique_lock<std::mutex> lock{ impl.mutex };
+		impl.finished.wait(lock, [&impl] { return impl.pending == 0; });
+	}
+
+	// Join the bands in order, as if a single writer had encoded them.
+	if (previous == nullptr)
+	{
+		VtWriter{ out }.Raw(RepaintPrefix);
+	}
+
+	bool          attribsValid = false;
+	std::uint16_t attribs      = 0;
+
+	for (int i = 0; i < bandCount; ++i)
+	{
+		const Impl::Band& band = impl.bands[i];
+		if (!band.summary.sent)
+		{
+			continue;
+		}
+
+		const auto begin = band.bytes.begin();
+		if (attribsValid && attribs == band.summary.firstAttribs)
+		{
+			out.insert(out.end(), begin, begin + static_cast<std::ptrdiff_t>(band.summary.sgrBegin));
+			out.insert(out.end(), begin + static_cast<std::ptrdiff_t>(band.summary.sgrEnd), band.bytes.end());
+		}
+		else
+		{
+			out.insert(out.end(), begin, band.bytes.end());
+		}
+
+		attribsValid = true;
+		attribs      = band.summary.lastAttribs;
+	}
+}
+
+} // namespace console
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace console
+{
+
+struct FrameCell;
+
+// Encodes console cells as a VT/ANSI escape sequence stream: UTF-8 text,
+// 16-colour SGR attributes and CUP cursor moves. This is what external
+// viewers (log files, pipes) receive, since they can't read the Win32 console.
+//
+// If previous is null the whole frame is repainted (attributes reset, screen cleared),
+// otherwise only the cells that differ from previous are sent.
+// Bytes are appended to out.
+void EncodeVtFrame(const FrameCell* cells, const FrameCell* previous, const int width, const int height, std::vector<std::uint8_t>& out);
+
+// Same output as EncodeVtFrame(), byte for byte, but the frame is split into fixed horizontal
+// bands of rows that are encoded in parallel into per-band buffers, then joined into out.
+// Worth it for full repaints and scene changes; frames under MinCellsPerBand cells per band
+// use fewer bands, down to encoding serially on the calling thread.
+class VtParallelEncoder final
+{
+public:
+
+	static constexpr int MinCellsPerBand = 2048;
+
+	// threads: number of bands, including the calling thread. 0 = one per hardware core.
+	explicit VtParallelEncoder(unsigned threads);
+	~VtParallelEncoder();
+
+	VtParallelEncoder(const VtParallelEncoder&) = delete;
+	VtParallelEncoder& operator=(const VtParallelEncoder&) = delete;
+
+	void Encode(const FrameCell* cells, const FrameCell* previous, const int width, const int height, std::vector<std::uint8_t>& out);
+
+	unsigned ThreadCount() const;
+
+private:
+
+	struct Impl;
+	std::unique_ptr<Impl> m_pImpl;
+};
+
+// A full-width scroll of rows [top, bottom), up for lines > 0, down for lines < 0.
+struct VtScroll
+{
+	int top    = 0;
+	int bottom = 0;
+	int lines  = 0;
+};
+
+// Emits DECSTBM + SU/SD so the terminal moves the rows itself, then applies the same
+// shift to previous, so that a following EncodeVtFrame() only sends the uncovered lines.
+void EncodeVtScroll(const VtScroll& scroll, FrameCell* previous, const int width, const int height, std::vector<std::uint8_t>& out);
+
+// Converts a console character (a UTF-16 code unit, control characters as blanks) to UTF-8.
+// Returns the number of bytes written to utf8[4].
+int ConsoleCharToUtf8(const std::uint16_t ch, char utf8[4]);
+
+// Same for the two cells of a double-width character. Characters outside the BMP are
+// stored as a surrogate pair, the high surrogate in the leading half and the low one in the trailing half.
+int ConsoleCharToUtf8(const std::uint16_t lead, const std::uint16_t trail, char utf8[4]);
+
+} // namespace console
@@ -0,0 +1,626 @@
+#include "Widgets.h"
+#include "Unicode.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace ui
+{
+
+namespace
+{
+
+int MainSize(const Size& size, const Direction direction)
+{
+	return (direction == Direction::Row) ? size.width : size.height;
+}
+
+int CrossSize(const Size& size, const Direction direction)
+{
+	return (direction == Direction::Row) ? size.height : size.width;
+}
+
+Rect Intersect(const Rect& a, const Rect& b)
+{
+	const int left   = std::max(a.x, b.x);
+	const int top    = std::max(a.y, b.y);
+	const int right  = std::min(a.x + a.width,  b.x + b.width);
+	const int bottom = std::min(a.y + a.height, b.y + b.height);
+
+	return Rect{ left, top, std::max(right - left, 0), std::max(bottom - top, 0) };
+}
+
+bool SameColour(const Colour& a, const Colour& b)
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+} // namespace
+
+Size MeasureText(const std::string_view text)
+{
+	Size size;
+	int lineWidth = 0;
+
+	if (!text.empty())
+	{
+		size.height = 1;
+	}
+
+	std::size_t i = 0;
+	while (i < text.size())
+	{
+		if (text[i] == '\n')
+		{
+			size.width = std::max(size.width, lineWidth);
+			lineWidth = 0;
+			++size.height;
+			++i;
+			continue;
+		}
+
+		if (text[i] == '\t')
+		{
+			lineWidth += 4; // Same as Screen::DrawText
+			++i;
+			continue;
+		}
+
+		const char32_t codePoint = console::DecodeUtf8(text, i);
+
+		if (codePoint < 0x20 || (codePoint >= 0x7F && codePoint < 0xA0))
+		{
+			continue;
+		}
+
+		// Narrow characters outside the BMP are drawn as U+FFFD, which is narrow as well.
+		lineWidth += console::CharWidth(codePoint);
+	}
+
+	size.width = std::max(size.width, lineWidth);
+	return size;
+}
+
+// ========================================================
+// Widget
+// ========================================================
+
+void Widget::AddChild(std::unique_ptr<Widget> child)
+{
+	assert(child != nullptr && child->m_parent == nullptr);
+
+	child->m_parent = this;
+	m_children.push_back(std::move(child));
+
+	InvalidateLayout();
+}
+
+void Widget::SetStyle(const LayoutStyle& style)
+{
+	m_style = style;
+	InvalidateLayout();
+}
+
+void Widget::SetBackground(const Colour background)
+{
+	if (SameColour(background, m_background))
+	{
+		return;
+	}
+
+	m_background = background;
+	Invalidate();
+}
+
+Rect Widget::ContentArea() const
+{
+	const int inset = BorderSize() + m_style.padding;
+
+	return Rect{
+		m_bounds.x + inset,
+		m_bounds.y + inset,
+		std::max(m_bounds.width  - (2 * inset), 0),
+		std::max(m_bounds.height - (2 * inset), 0),
+	};
+}
+
+void Widget::Invalidate()
+{
+	m_dirty = true;
+
+	// Ancestors already flagged have the rest of the path flagged too.
+	for (Widget* parent = m_parent; parent != nullptr && !parent->m_childDirty; parent = parent->m_parent)
+	{
+		parent->m_childDirty = true;
+	}
+}
+
+void Widget::InvalidateLayout()
+{
+	m_layoutDirty = true;
+
+	for (Widget* parent = m_parent; parent != nullptr && !parent->m_layoutDirty; parent = parent->m_parent)
+	{
+		parent->m_layoutDirty = true;
+	}
+}
+
+// Bottom-up pass: the size each widget asks for, from its style, content and children.
+// A subtree without a pending layout keeps its size from the last pass.
+void Widget::Measure()
+{
+	if (!m_layoutDirty)
+	{
+		return;
+	}
+
+	const Direction direction = m_style.direction;
+
+	int main  = 0;
+	int cross = 0;
+
+	for (const auto& child : m_children)
+	{
+		child->Measure();
+		main += MainSize(child->m_measured, direction);
+		cross = std::max(cross, CrossSize(child->m_measured, direction));
+	}
+
+	if (!m_children.empty())
+	{
+		main += m_style.gap * static_cast<int>(m_children.size() - 1);
+	}
+
+	const Size content  = MeasureContent();
+	const Size children = (direction == Direction::Row) ? Size{ main, cross } : Size{ cross, main };
+	const int  inset    = 2 * (BorderSize() + m_style.padding);
+
+	m_measured.width  = (m_style.width  > 0) ? m_style.width  : std::max(content.width,  children.width)  + inset;
+	m_measured.height = (m_style.height > 0) ? m_style.height : std::max(content.height, children.height) + inset;
+}
+
+// Top-down pass: places the children inside the content area.
+// Returns true if this widget moved or was resized. A subtree without a pending layout
+// that keeps its bounds is left as it is.
+bool Widget::Arrange(const Rect& bounds)
+{
+	const bool moved = (bounds != m_bounds);
+	if (!moved && !m_layoutDirty)
+	{
+		return false;
+	}
+
+	if (moved)
+	{
+		m_bounds = bounds;
+		m_dirty  = true;
+	}
+
+	m_layoutDirty = false;
+
+	const Direction direction = m_style.direction;
+	const Rect content = ContentArea();
+	const int  available = (direction == Direction::Row) ? content.width  : content.height;
+	const int  crossArea = (direction == Direction::Row) ? content.height : content.width;
+
+	int used      = 0;
+	int totalGrow = 0;
+
+	for (const auto& child : m_children)
+	{
+		used      += MainSize(child->m_measured, direction);
+		totalGrow += child->m_style.grow;
+	}
+
+	if (!m_children.empty())
+	{
+		used += m_style.gap * static_cast<int>(m_children.size() - 1);
+	}
+
+	int leftover = std::max(available - used, 0);
+	int growLeft = totalGrow;
+	int position = (direction == Direction::Row) ? content.x : content.y;
+
+	for (const auto& child : m_children)
+	{
+		int mainSize = MainSize(child->m_measured, direction);
+
+		// Split the leftover space by grow factor. The last growing child takes the rounding remainder.
+		if (child->m_style.grow > 0)
+		{
+			const int share = (leftover * child->m_style.grow) / growLeft;
+			mainSize += share;
+			leftover -= share;
+			growLeft -= child->m_style.grow;
+		}
+
+		const int fixedCross = (direction == Direction::Row) ? child->m_style.height : child->m_style.width;
+		int crossSize = CrossSize(child->m_measured, direction);
+		int crossPos  = 0;
+
+		switch (m_style.align)
+		{
+		case Align::Stretch:
+			crossSize = (fixedCross > 0) ? fixedCross : crossArea;
+			break;
+
+		case Align::Start:
+			break;
+
+		case Align::Center:
+			crossPos = std::max((crossArea - crossSize) / 2, 0);
+			break;
+
+		case Align::End:
+			crossPos = std::max(crossArea - crossSize, 0);
+			break;
+		}
+
+		const Rect area = (direction == Direction::Row)
+			? Rect{ position, content.y + crossPos, mainSize, crossSize }
+			: Rect{ content.x + crossPos, position, crossSize, mainSize };
+
+		// A child that moved leaves stale cells behind, so repaint the whole parent.
+		if (child->Arrange(Intersect(area, content)))
+		{
+			m_dirty = true;
+		}
+
+		if (child->m_dirty || child->m_childDirty)
+		{
+			m_childDirty = true;
+		}
+
+		position += mainSize + m_style.gap;
+	}
+
+	return moved;
+}
+
+void Widget::Render(Screen& screen, bool repaint, int& paintCount)
+{
+	// Painting a widget clears its area, so all of its children have to be painted again.
+	repaint = repaint || m_dirty;
+
+	if (repaint && m_bounds.width > 0 && m_bounds.height > 0)
+	{
+		screen.Fill(console::Point{ m_bounds.x, m_bounds.y }, m_bounds.width, m_bounds.height, m_background);
+		Paint(screen);
+		++paintCount;
+	}
+
+	if (repaint || m_childDirty)
+	{
+		for (const auto& child : m_children)
+		{
+			child->Render(screen, repaint, paintCount);
+		}
+	}
+
+	m_dirty      = false;
+	m_childDirty = false;
+}
+
+// ========================================================
+// Panel
+// ========================================================
+
+Panel::Panel(std::string title, const console::LineStyle border, const Colour borderColour)
+	: m_title{ std::move(title) }
+	, m_border{ border }
+	, m_borderColour{ borderColour }
+	, m_hasBorder{ true }
+{ }
+
+void Panel::SetTitle(const std::string_view title)
+{
+	if (title == m_title)
+	{
+		return;
+	}
+
+	m_title.assign(title.data(), title.size());
+	InvalidateLayout();
+	Invalidate();
+}
+
+Size Panel::MeasureContent() const
+{
+	// Room for the title and a blank on each side of it.
+	const Size title = MeasureText(m_title);
+	return Size{ (title.width > 0) ? title.width + 2 : 0, 0 };
+}
+
+void Panel::Paint(Screen& screen) const
+{
+	const Rect& bounds = Bounds();
+
+	if (!m_hasBorder || bounds.width < 2 || bounds.height < 2)
+	{
+		return;
+	}
+
+	// DrawRectangle puts the right edge at x + width and halves the height (console cells are about 2:1).
+	console::Rectangle border;
+	border.origin = console::Point{ bounds.x, bounds.y };
+	border.width  = bounds.width - 1;
+	border.height = (bounds.height - 1) * 2;
+	border.border = m_border;
+	screen.DrawRectangle(border, m_borderColour, Background());
+
+	if (!m_title.empty() && bounds.width > 4)
+	{
+		console::TextBox titleBox;
+		titleBox.origin = console::Point{ bounds.x + 2, bounds.y };
+		titleBox.width  = bounds.width - 4;
+		titleBox.height = 1;
+
+		const int titleWidth = std::min(MeasureText(m_title).width, titleBox.width);
+
+		screen.DrawChar(' ', console::Point{ bounds.x + 1, bounds.y }, m_borderColour, Background());
+		screen.DrawText(m_title, titleBox, m_borderColour, Background());
+		screen.DrawChar(' ', console::Point{ bounds.x + 2 + titleWidth, bounds.y }, m_borderColour, Background());
+	}
+}
+
+// ========================================================
+// Label
+// ========================================================
+
+Label::Label(std::string text, const Colour foreground)
+	: m_text{ std::move(text) }
+	, m_foreground{ foreground }
+{ }
+
+void Label::SetText(const std::string_view text)
+{
+	if (text == m_text)
+	{
+		return;
+	}
+
+	const Size before = MeasureText(m_text);
+	m_text.assign(text.data(), text.size());
+	const Size after = MeasureText(m_text);
+
+	// A fixed-size label only needs repainting.
+	const bool sizedByContent = (Style().width == 0 || Style().height == 0);
+	if (sizedByContent && (before.width != after.width || before.height != after.height))
+	{
+		InvalidateLayout();
+	}
+
+	Invalidate();
+}
+
+void Label::SetForeground(const Colour foreground)
+{
+	if (SameColour(foreground, m_foreground))
+	{
+		return;
+	}
+
+	m_foreground = foreground;
+	Invalidate();
+}
+
+void Label::SetOverflow(const console::TextOverflow overflow)
+{
+	if (overflow == m_overflow)
+	{
+		return;
+	}
+
+	m_overflow = overflow;
+	Invalidate();
+}
+
+Size Label::MeasureContent() const
+{
+	return MeasureText(m_text);
+}
+
+void Label::Paint(Screen& screen) const
+{
+	const Rect content = ContentArea();
+
+	console::TextBox box;
+	box.origin   = console::Point{ content.x, content.y };
+	box.width    = content.width;
+	box.height   = content.height;
+	box.overflow = m_overflow;
+
+	screen.DrawText(m_text, box, m_foreground, Background());
+}
+
+// ========================================================
+// ProgressBar
+// ========================================================
+
+ProgressBar::ProgressBar(const Colour fill, const Colour track)
+	: m_fill{ fill }
+	, m_track{ track }
+{ }
+
+int ProgressBar::FilledCells(const float value) const
+{
+	return static_cast<int>((value * static_cast<float>(ContentArea().width)) + 0.5f);
+}
+
+void ProgressBar::SetValue(float value)
+{
+	value = std::min(std::max(value, 0.0f), 1.0f);
+
+	if (FilledCells(value) != FilledCells(m_value))
+	{
+		Invalidate();
+	}
+
+	m_value = value;
+}
+
+void ProgressBar::Paint(Screen& screen) const
+{
+	const Rect content = ContentArea();
+	const int filled = FilledCells(m_value);
+
+	screen.Fill(console::Point{ content.x, content.y }, filled, content.height, m_fill);
+	screen.Fill(console::Point{ content.x + filled, content.y }, content.width - filled, content.height, m_track);
+}
+
+// ========================================================
+// Table
+// ========================================================
+
+void Table::AddColumn(std::string header, const int width)
+{
+	assert(width > 0);
+
+	const std::size_t oldColumns = m_columns.size();
+	const std::size_t newColumns = oldColumns + 1;
+
+	Column column;
+	column.header = std::move(header);
+	column.width  = width;
+	m_columns.push_back(std::move(column));
+
+	// Re-stride the existing rows.
+	std::vector<std::string> cells(static_cast<std::size_t>(m_rowCount) * newColumns);
+	for (std::size_t row = 0; row < static_cast<std::size_t>(m_rowCount); ++row)
+	{
+		for (std::size_t col = 0; col < oldColumns; ++col)
+		{
+			cells[(row * newColumns) + col] = std::move(m_cells[(row * oldColumns) + col]);
+		}
+	}
+	m_cells.swap(cells);
+
+	InvalidateLayout();
+	Invalidate();
+}
+
+void Table::SetRowCount(const int rows)
+{
+	assert(rows >= 0);
+
+	if (rows == m_rowCount)
+	{
+		return;
+	}
+
+	m_rowCount = rows;
+	m_cells.resize(static_cast<std::size_t>(rows) * m_columns.size());
+
+	InvalidateLayout();
+	Invalidate();
+}
+
+void Table::SetCell(const int row, const int column, const std::string_view text)
+{
+	assert(row >= 0 && row < m_rowCount);
+	assert(column >= 0 && column < ColumnCount());
+
+	std::string& cell = m_cells[(static_cast<std::size_t>(row) * m_columns.size()) + column];
+	if (text == cell)
+	{
+		return;
+	}
+
+	cell.assign(text.data(), text.size());
+	Invalidate();
+}
+
+void Table::SetColours(const Colour text, const Colour header, const Colour headerBackground)
+{
+	if (SameColour(text, m_text) && SameColour(header, m_header) && SameColour(headerBackground, m_headerBackground))
+	{
+		return;
+	}
+
+	m_text             = text;
+	m_header           = header;
+	m_headerBackground = headerBackground;
+	Invalidate();
+}
+
+Size Table::MeasureContent() const
+{
+	Size size;
+
+	for (const Column& column : m_columns)
+	{
+		size.width += column.width;
+	}
+
+	// One blank between columns, one header row.
+	if (!m_columns.empty())
+	{
+		size.width += static_cast<int>(m_columns.size() - 1);
+	}
+	size.height = m_rowCount + 1;
+
+	return size;
+}
+
+void Table::Paint(Screen& screen) const
+{
+	const Rect content = ContentArea();
+	if (content.width <= 0 || content.height <= 0)
+	{
+		return;
+	}
+
+	const int right = content.x + content.width;
+	const int rows  = std::min(m_rowCount, content.height - 1);
+
+	screen.Fill(console::Point{ content.x, content.y }, content.width, 1, m_headerBackground);
+
+	console::TextBox box;
+	box.height = 1;
+
+	int x = content.x;
+	for (std::size_t col = 0; col < m_columns.size() && x < right; ++col)
+	{
+		box.width = std::min(m_columns[col].width, right - x);
+
+		box.origin = console::Point{ x, content.y };
+		screen.DrawText(m_columns[col].header, box, m_header, m_headerBackground);
+
+		for (int row = 0; row < rows; ++row)
+		{
+			box.origin = console::Point{ x, content.y + 1 + row };
+			screen.DrawText(m_cells[(static_cast<std::size_t>(row) * m_columns.size()) + col], box, m_text, Background());
+		}
+
+		x += m_columns[col].width + 1;
+	}
+}
+
+// ========================================================
+// WidgetTree
+// ========================================================
+
+WidgetTree::WidgetTree(Screen& screen)
+	: m_screen{ screen }
+{ }
+
+void WidgetTree::Render()
+{
+	m_screen.PollResize();
+
+	// The last column isn't usable, characters drawn there wrap to the next line (see Screen::AddCharToBuffer).
+	const Rect screenArea{ 0, 0, m_screen.Width() - 1, m_screen.Height() };
+
+	if (m_root.m_layoutDirty || m_root.m_bounds != screenArea)
+	{
+		m_root.Measure();
+		m_root.Arrange(screenArea);
+	}
+
+	m_paintCount = 0;
+	m_root.Render(m_screen, false, m_paintCount);
+
+	m_screen.Present();
+}
+
+} // namespace ui
@@ -0,0 +1,292 @@
+#pragma once
+
+#include "Screen.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Retained-mode widgets on top of console::Screen.
+//
+// Widgets live in a tree owned by a WidgetTree. Layout is flexbox-like: a widget stacks
+// its children along a row or column, sized by their fixed size, their content or a
+// share of the leftover space. Layout results are cached until something calls
+// InvalidateLayout(). Changing a widget's data only marks that widget for repainting,
+// and WidgetTree::Render() redraws just the marked widgets. Everything else stays as-is
+// in the Screen's retained character buffer.
+namespace ui
+{
+
+using console::Colour;
+using console::Screen;
+
+struct Size
+{
+	int width  = 0;
+	int height = 0;
+};
+
+struct Rect
+{
+	int x      = 0;
+	int y      = 0;
+	int width  = 0;
+	int height = 0;
+};
+
+inline bool operator==(const Rect& a, const Rect& b) { return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height; }
+inline bool operator!=(const Rect& a, const Rect& b) { return !(a == b); }
+
+enum class Direction : std::uint8_t
+{
+	Row,    // Children left to right
+	Column, // Children top to bottom
+};
+
+enum class Align : std::uint8_t
+{
+	Stretch, // Fill the cross axis, unless the child has a fixed size
+	Start,
+	Center,
+	End,
+};
+
+struct LayoutStyle
+{
+	int width  = 0; // Fixed size, 0 to size to content
+	int height = 0;
+	int grow   = 0; // Share of the parent's leftover space along its direction
+
+	// How this widget lays out its own children.
+	Direction direction = Direction::Column;
+	Align     align     = Align::Stretch;
+	int       padding   = 0;
+	int       gap       = 0; // Cells between children
+};
+
+class WidgetTree;
+
+// Base widget, also usable as a plain container.
+class Widget
+{
+public:
+
+	Widget() = default;
+	virtual ~Widget() = default;
+
+	Widget(const Widget&) = delete;
+	Widget& operator=(const Widget&) = delete;
+
+	// Creates a child widget at the end of the child list and returns it.
+	template<typename T, typename... Args>
+	T& Add(Args&&... args)
+	{
+		auto child = std::make_unique<T>(std::forward<Args>(args)...);
+		T& ref = *child;
+		AddChild(std::move(child));
+		return ref;
+	}
+
+	void SetStyle(const LayoutStyle& style);
+	void SetBackground(const Colour background);
+
+	const LayoutStyle& Style() const { return m_style; }
+	Colour Background() const { return m_background; }
+
+	// Screen area from the last layout, clipped to the parent.
+	const Rect& Bounds() const { return m_bounds; }
+
+	// Area inside the border and padding.
+	Rect ContentArea() const;
+
+	// Redraw this widget (and its children) on the next render.
+	void Invalidate();
+
+	// Redo the layout on the next render, e.g. because the content size changed.
+	void InvalidateLayout();
+
+protected:
+
+	// Size of the content when the style doesn't fix it. Children are accounted for separately.
+	virtual Size MeasureContent() const { return {}; }
+
+	// Cells taken by a border on each side.
+	virtual int BorderSize() const { return 0; }
+
+	// Draws the widget. Bounds() are already cleared to the background colour; children are drawn afterwards.
+	virtual void Paint(Screen& /*screen*/) const { }
+
+private:
+
+	friend class WidgetTree;
+
+	void AddChild(std::unique_ptr<Widget> child);
+	void Measure();
+	bool Arrange(const Rect& bounds);
+	void Render(Screen& screen, bool repaint, int& paintCount);
+
+	Widget*     m_parent = nullptr;
+	LayoutStyle m_style;
+	Colour      m_background = Colour::Black;
+	Size        m_measured;
+	Rect        m_bounds;
+
+	bool m_dirty       = true; // Needs repainting
+	bool m_childDirty  = true; // Some descendant needs repainting
+	bool m_layoutDirty = true; // Needs a layout pass (set on the whole path to the root)
+
+	std::vector<std::unique_ptr<Widget>> m_children;
+};
+
+// Container with an optional border and title.
+class Panel final : public Widget
+{
+public:
+
+	Panel() = default;
+	explicit Panel(std::string title, const console::LineStyle border = console::LineStyle::Default, const Colour borderColour = Colour::White);
+
+	void SetTitle(const std::string_view title);
+
+protected:
+
+	Size MeasureContent() const override;
+	int  BorderSize() const override { return m_hasBorder ? 1 : 0; }
+	void Paint(Screen& screen) const override;
+
+private:
+
+	std::string        m_title;
+	console::LineStyle m_border       = console::LineStyle::Default;
+	Colour             m_borderColour = Colour::White;
+	bool               m_hasBorder    = false;
+};
+
+// UTF-8 text, clipped or word-wrapped to the widget area.
+class Label final : public Widget
+{
+public:
+
+	Label() = default;
+	explicit Label(std::string text, const Colour foreground = Colour::White);
+
+	// Only invalidates if the text changed. Relayout is only needed if the text size changed.
+	void SetText(const std::string_view text);
+
+	// Only invalidate if the value changed.
+	void SetForeground(const Colour foreground);
+	void SetOverflow(const console::TextOverflow overflow);
+
+	const std::string& Text() const { return m_text; }
+
+protected:
+
+	Size MeasureContent() const override;
+	void Paint(Screen& screen) const override;
+
+private:
+
+	std::string            m_text;
+	Colour                 m_foreground = Colour::White;
+	console::TextOverflow  m_overflow   = console::TextOverflow::Clip;
+};
+
+// Horizontal bar filled proportionally to a [0, 1] value.
+class ProgressBar final : public Widget
+{
+public:
+
+	ProgressBar() = default;
+	ProgressBar(const Colour fill, const Colour track);
+
+	// Only invalidates if the number of filled cells changes.
+	void SetValue(const float value);
+	float Value() const { return m_value; }
+
+protected:
+
+	Size MeasureContent() const override { return Size{ 10, 1 }; }
+	void Paint(Screen& screen) const override;
+
+private:
+
+	int FilledCells(const float value) const;
+
+	float  m_value = 0.0f;
+	Colour m_fill  = Colour::BrightGreen;
+	Colour m_track = Colour::Gray;
+};
+
+// Fixed-width columns with a header row. Cell text is clipped to the column width.
+class Table final : public Widget
+{
+public:
+
+	Table() = default;
+
+	void AddColumn(std::string header, const int width);
+	void SetRowCount(const int rows);
+
+	// Only invalidates if the text changed.
+	void SetCell(const int row, const int column, const std::string_view text);
+
+	void SetColours(const Colour text, const Colour header, const Colour headerBackground);
+
+	int RowCount()    const { return m_rowCount; }
+	int ColumnCount() const { return static_cast<int>(m_columns.size()); }
+
+protected:
+
+	Size MeasureContent() const override;
+	void Paint(Screen& screen) const override;
+
+private:
+
+	struct Column
+	{
+		std::string header;
+		int         width = 0;
+	};
+
+	std::vector<Column>      m_columns;
+	std::vector<std::string> m_cells; // Row-major
+	int                      m_rowCount = 0;
+
+	Colour m_text             = Colour::White;
+	Colour m_header           = Colour::White;
+	Colour m_headerBackground = Colour::DarkBlue;
+};
+
+// Owns the root widget and renders the tree to a Screen.
+class WidgetTree final
+{
+public:
+
+	explicit WidgetTree(Screen& screen);
+
+	// Covers the whole screen and follows its size.
+	Widget& Root() { return m_root; }
+
+	// Lays out the tree if needed, redraws the widgets that changed and presents the screen.
+	void Render();
+
+	// Repaints everything on the next render, e.g. after Screen::Clear().
+	void InvalidateAll() { m_root.Invalidate(); }
+
+	// Widgets drawn by the last Render().
+	int LastPaintCount() const { return m_paintCount; }
+
+private:
+
+	Screen& m_screen;
+	Widget  m_root;
+	int     m_paintCount = 0;
+};
+
+// Display width of UTF-8 text in console cells: widest line and number of lines.
+Size MeasureText(const std::string_view text);
+
+} // namespace ui